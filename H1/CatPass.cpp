@@ -12,15 +12,44 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/Format.h"
 #include <map>
+#include <vector>
 #include <assert.h>
 #include <string.h>
 
 using namespace llvm;
 
+// the census of every function with CAT calls, written once per module
+static cl::opt<std::string> CensusFile("cat-census",
+  cl::desc("Write the per-function CAT call census (CSV for *.csv, JSON lines otherwise)"),
+  cl::value_desc("file"), cl::init(""));
+
+// e.g. a census taken before an optimization stage ran, to see what it removed
+static cl::opt<std::string> CensusBaseline("cat-census-diff",
+  cl::desc("Print the CAT call sites removed per function since an earlier CSV census"),
+  cl::value_desc("file"), cl::init(""));
+
 namespace {
+  // the CAT API, in the order of the census columns
+  const char* const catApiNames[] = {
+    "CAT_binary_add",
+    "CAT_binary_sub",
+    "CAT_create_signed_value",
+    "CAT_get_signed_value",
+  };
+  const unsigned numCatApis = sizeof(catApiNames) / sizeof(catApiNames[0]);
+
   struct CAT : public FunctionPass {
     static char ID; 
+    // function -> number of calls to each CAT API, built in doFinalization
+    std::map<Function*, std::vector<int>> census;
+    // census rows in module order
+    std::vector<Function*> censusOrder;
 
     CAT() : FunctionPass(ID) {}
 
@@ -31,36 +60,195 @@ namespace {
       return false;
     }
 
-    // This function is invoked once per function compiled
-    // The LLVM IR of the input functions is ready and it can be analyzed and/or transformed
-    bool runOnFunction (Function &F) override {
-      //errs() << "Hello LLVM World at \"runOnFunction\"\n" ;
-      bool modified = false;
-      std::map <std::string, int> funcMap;
-      funcMap["CAT_binary_add"] = 0;
-      funcMap["CAT_binary_sub"] = 0;
-      funcMap["CAT_create_signed_value"] = 0;
-      funcMap["CAT_get_signed_value"] = 0;
-      std::string funcName = F.getName();
-      //if (funcName == "CAT_execution") {
-        for (auto& B : F) {
-          for (auto& I : B) {
-            if (auto* call = dyn_cast<CallInst>(&I)) {
-              Function *callee;
-              callee = call->getCalledFunction();
-              funcName = callee->getName();
-              if (funcMap.find(funcName) != funcMap.end()) {
-                ++funcMap[funcName];
-              } 
+    // the census is taken once every function went through the passes
+    // scheduled before this one, so it reflects the IR at this point of the
+    // pipeline; the per-function histograms are printed from it too
+    bool doFinalization (Module &M) override {
+      // walk the use lists of the CAT API declarations instead of every
+      // instruction, so the census costs O(#CAT call sites)
+      census.clear();
+      censusOrder.clear();
+      for (unsigned i = 0; i < numCatApis; i++) {
+        Function* api = M.getFunction(catApiNames[i]);
+        if (api == NULL) {
+          continue;
+        }
+        for (auto user : api->users()) {
+          auto* call = dyn_cast<CallInst>(user);
+          // skip uses that are not the callee, e.g. the API passed as an argument
+          if (call == NULL || call->getCalledFunction() != api) {
+            continue;
+          }
+          auto& counts = census[call->getParent()->getParent()];
+          counts.resize(numCatApis, 0);
+          counts[i]++;
+        }
+      }
+      for (auto& F : M) {
+        if (census.find(&F) != census.end()) {
+          censusOrder.push_back(&F);
+        }
+      }
+      if (!CensusFile.empty()) {
+        writeCensus(CensusFile);
+      }
+      if (!CensusBaseline.empty()) {
+        diffCensus(CensusBaseline);
+      }
+      for (auto* F : censusOrder) {
+        //if (funcName == "CAT_execution") {
+          for (unsigned i = 0; i < numCatApis; i++) {
+            if (census[F][i] != 0) {
+              errs() << "H1: \"" <<  "CAT_execution" << "\": " << catApiNames[i] << ": " << census[F][i] << "\n";
             }
           }
+        //}
+      }
+      return false;
+    }
+
+    static void writeJSONString(raw_ostream &OS, StringRef str) {
+      OS << '"';
+      for (char c : str) {
+        if (c == '"' || c == '\\') {
+          OS << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+          OS << format("\\u%04x", c);
+        } else {
+          OS << c;
         }
-        for (auto& p : funcMap) {
-          if (p.second != 0) {
-            errs() << "H1: \"" <<  "CAT_execution" << "\": " << p.first << ": " << p.second << "\n";
+      }
+      OS << '"';
+    }
+
+    // a CSV field, quoted with doubled quotes (RFC 4180)
+    static void writeCSVString(raw_ostream &OS, StringRef str) {
+      OS << '"';
+      for (char c : str) {
+        if (c == '"') {
+          OS << '"';
+        }
+        OS << c;
+      }
+      OS << '"';
+    }
+
+    // splits a line written by writeCensus into its fields
+    static std::vector<std::string> splitCSVLine(StringRef line) {
+      std::vector<std::string> fields(1);
+      bool quoted = false;
+      for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (quoted) {
+          if (c != '"') {
+            fields.back() += c;
+          } else if (i + 1 < line.size() && line[i + 1] == '"') {
+            fields.back() += c;
+            i++;
+          } else {
+            quoted = false;
           }
+        } else if (c == '"') {
+          quoted = true;
+        } else if (c == ',') {
+          fields.push_back("");
+        } else {
+          fields.back() += c;
         }
-      //}
+      }
+      return fields;
+    }
+
+    void writeCensus(const std::string &path) {
+      std::error_code EC;
+      raw_fd_ostream OS(path, EC, sys::fs::F_Text);
+      if (EC) {
+        errs() << "H1: cannot open " << path << ": " << EC.message() << "\n";
+        return;
+      }
+      bool csv = StringRef(path).endswith(".csv");
+      if (csv) {
+        OS << "function";
+        for (unsigned i = 0; i < numCatApis; i++) {
+          OS << "," << catApiNames[i];
+        }
+        OS << "\n";
+      }
+      for (auto* F : censusOrder) {
+        auto& counts = census[F];
+        if (csv) {
+          writeCSVString(OS, F->getName());
+          for (unsigned i = 0; i < numCatApis; i++) {
+            OS << "," << counts[i];
+          }
+          OS << "\n";
+          continue;
+        }
+        OS << "{\"function\":";
+        writeJSONString(OS, F->getName());
+        for (unsigned i = 0; i < numCatApis; i++) {
+          OS << ",\"" << catApiNames[i] << "\":" << counts[i];
+        }
+        OS << "}\n";
+      }
+    }
+
+    // compares with a CSV census written by -cat-census; prints one line
+    // per function and API whose count changed, then the totals
+    void diffCensus(const std::string &path) {
+      auto buffer = MemoryBuffer::getFile(path);
+      if (!buffer) {
+        errs() << "H1: cannot read " << path << ": " << buffer.getError().message() << "\n";
+        return;
+      }
+      std::map<std::string, std::vector<int>> before;
+      for (line_iterator line(**buffer); !line.is_at_eof(); ++line) {
+        std::vector<std::string> fields = splitCSVLine(*line);
+        if (fields.size() != numCatApis + 1 || line->startswith("function,")) {
+          continue;
+        }
+        auto& counts = before[fields[0]];
+        counts.resize(numCatApis, 0);
+        for (unsigned i = 0; i < numCatApis; i++) {
+          StringRef(fields[i + 1]).getAsInteger(10, counts[i]);
+        }
+      }
+      std::map<std::string, std::vector<int>> after;
+      for (auto* F : censusOrder) {
+        after[F->getName()] = census[F];
+      }
+      std::vector<int> totalBefore(numCatApis, 0), totalAfter(numCatApis, 0);
+      std::vector<int> none(numCatApis, 0);
+      for (auto& p : before) {
+        if (after.find(p.first) == after.end()) {
+          after[p.first] = none;
+        }
+      }
+      for (auto& p : after) {
+        auto it = before.find(p.first);
+        const std::vector<int> &old = it == before.end() ? none : it->second;
+        for (unsigned i = 0; i < numCatApis; i++) {
+          totalBefore[i] += old[i];
+          totalAfter[i] += p.second[i];
+          if (old[i] != p.second[i]) {
+            errs() << "H1 diff: \"" << p.first << "\": " << catApiNames[i] << ": " << old[i] << " -> " << p.second[i]
+                   << " (removed " << old[i] - p.second[i] << ")\n";
+          }
+        }
+      }
+      for (unsigned i = 0; i < numCatApis; i++) {
+        errs() << "H1 diff: total: " << catApiNames[i] << ": " << totalBefore[i] << " -> " << totalAfter[i]
+               << " (removed " << totalBefore[i] - totalAfter[i] << ")\n";
+      }
+    }
+
+    // This function is invoked once per function compiled
+    // The LLVM IR of the input functions is ready and it can be analyzed and/or transformed
+    bool runOnFunction (Function &F) override {
+      //errs() << "Hello LLVM World at \"runOnFunction\"\n" ;
+      bool modified = false;
+      // the histograms come from the census in doFinalization; nothing is
+      // scanned here
       return modified;
     }
 
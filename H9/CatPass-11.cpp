@@ -39,6 +39,8 @@ namespace {
     static char ID; 
     std::map<Function*,function_info> summary;
     std::string cat_api[4] = {"CAT_binary_add", "CAT_binary_sub", "CAT_create_signed_value","CAT_get_signed_value"};
+    // declarations of the CAT API in the current module, resolved once in doInitialization
+    Function* cat_function[4];
     std::set<Function*> function_with_cat;
 
     std::set<BasicBlock*> bbWorkList;
@@ -55,6 +57,7 @@ namespace {
       for(int i = 0; i < 4; i++){
         Function *CAT_function;
         CAT_function = M.getFunction(cat_api[i]);
+        cat_function[i] = CAT_function;
         if(CAT_function == NULL){
           continue;
         }
@@ -99,7 +102,7 @@ namespace {
                 }
                 if(auto* call = dyn_cast<CallInst>(retOperand)){
                   // 1. the function returns a CAT_create_signed_value instruction
-                  if(call->getCalledFunction()->getName() == cat_api[2]){
+                  if(is_cat_api(call->getCalledFunction(), 2)){
                     summary[&F].constant = true;
                     Value* v = call->getOperand(0);
                     summary[&F].value[true] = v;
@@ -150,7 +153,7 @@ namespace {
                       }
                     }
                     else{
-                      if(cast<CallInst>(phi->getIncomingValue(i))->getCalledFunction()->getName() != cat_api[2]){
+                      if(!is_cat_api(cast<CallInst>(phi->getIncomingValue(i))->getCalledFunction(), 2)){
                         allConst = false;
                         break;
                       }
@@ -229,6 +232,12 @@ namespace {
     // some utility functions
     // --------------------------
 
+    // true if f is the CAT API function cat_api[api], a pointer comparison
+    // instead of a string comparison on every call
+    bool is_cat_api(Function* f, int api) const{
+      return f != NULL && f == cat_function[api];
+    }
+
     private: class GEN_KILL{
     private:
       std::vector<Instruction*> gen;
@@ -309,13 +318,13 @@ namespace {
       }
       else if(isa<CallInst>(value)){
         CallInst* value_instruction = cast<CallInst>(value);
-        if(value_instruction->getCalledFunction()->getName() == cat_api[3]){
+        if(is_cat_api(value_instruction->getCalledFunction(), 3)){
           value = value_instruction->getOperand(0);
           if(isa<Argument>(value)){
             // if the CAT_data comes from argument, get the value at runtime
             Value* runtime_value = callin->getArgOperand(0);
             if(CallInst* runtime_instruction = dyn_cast<CallInst>(runtime_value)){
-              if(runtime_instruction->getCalledFunction()->getName() == cat_api[2]){
+              if(is_cat_api(runtime_instruction->getCalledFunction(), 2)){
                 runtime_value = runtime_instruction->getArgOperand(0);
                 if(isa<ConstantInt>(runtime_value)){
                   ConstantInt* constant = cast<ConstantInt>(runtime_value);
@@ -436,7 +445,7 @@ namespace {
                   // for each argument of this call
                   for(int j = 0 ; j < call_function->getNumArgOperands(); j++){
                     if(auto call = dyn_cast<CallInst>(call_function->getArgOperand(j))){
-                      if(call->getCalledFunction()->getName() == cat_api[2]){
+                      if(is_cat_api(call->getCalledFunction(), 2)){
                         // get the argument that is propagate into the CAT function
                         Value* v = call->getOperand(0);
                         if(isa<ConstantInt>(v)){
@@ -497,7 +506,7 @@ namespace {
 
       for (Instruction* i : inst_vec){
           if(auto* call = dyn_cast<CallInst>(i)){
-            if(call->getCalledFunction()->getName() == cat_api[3]){
+            if(is_cat_api(call->getCalledFunction(), 3)){
               Value* arg_to_be_replaced = call->getArgOperand(0);
               if(isa<Argument>(arg_to_be_replaced)){
                 int index = arg_map[arg_to_be_replaced];
@@ -595,7 +604,7 @@ namespace {
           if (auto* call = dyn_cast<CallInst>(&i))
           {
             // store GEN set
-            if(call->getCalledFunction()->getName() == cat_api[0]||call->getCalledFunction()->getName() == cat_api[1]||call->getCalledFunction()->getName() == cat_api[2])
+            if(is_cat_api(call->getCalledFunction(), 0)||is_cat_api(call->getCalledFunction(), 1)||is_cat_api(call->getCalledFunction(), 2))
             {
               std::map<Instruction*, GEN_KILL>::iterator it = map.find(call);
               if(it != map.end()){
@@ -604,7 +613,7 @@ namespace {
             }
 
             // store KILL set
-            if(call->getCalledFunction()->getName() == cat_api[0]||call->getCalledFunction()->getName() == cat_api[1])
+            if(is_cat_api(call->getCalledFunction(), 0)||is_cat_api(call->getCalledFunction(), 1))
             {
               if(auto* inst = dyn_cast<Instruction>(call->getArgOperand(0)))
               {
@@ -740,10 +749,10 @@ namespace {
         if(isa<CallInst>(i)){
           CallInst* ci = cast<CallInst>(i);
           if(ci->getNumArgOperands()>0){
-            if(ci->getCalledFunction()->getName() != cat_api[3] && ci->getCalledFunction()->getName() != cat_api[0] && ci->getCalledFunction()->getName() != cat_api[1]){
+            if(!is_cat_api(ci->getCalledFunction(), 3) && !is_cat_api(ci->getCalledFunction(), 0) && !is_cat_api(ci->getCalledFunction(), 1)){
               if(isa<CallInst>(ci->getArgOperand(0))){
                 CallInst* esc = cast<CallInst>(ci->getArgOperand(0));
-                if(esc->getCalledFunction()->getName() == cat_api[2]){
+                if(is_cat_api(esc->getCalledFunction(), 2)){
                   escape_var.insert(esc);
                 }
               }
@@ -756,7 +765,7 @@ namespace {
         if(auto* call = dyn_cast<CallInst>(i)){
           Function* callee = call->getCalledFunction();
           // Instruction i is a use of a variable
-          if(callee->getName() == cat_api[3]){
+          if(is_cat_api(callee, 3)){
             auto num = find(inst_set.begin(),inst_set.end(),call)-inst_set.begin();
             bool const_reach = false;
             Value* arg_of_use = call->getOperand(0);
@@ -776,7 +785,7 @@ namespace {
                 bool escape_and_change = false;
                 for(auto* inst: in_set[num]){
                   auto* inst_call = dyn_cast<CallInst>(inst);
-                  if(inst_call->getCalledFunction()->getName() == cat_api[0]||inst_call->getCalledFunction()->getName() == cat_api[1]){
+                  if(is_cat_api(inst_call->getCalledFunction(), 0)||is_cat_api(inst_call->getCalledFunction(), 1)){
                     if(deps.depends(call,inst_call,false)){
                       escape_and_change = true;
                       break;
@@ -852,7 +861,7 @@ namespace {
                   }
                   else if(escape_var.find(def)!=escape_var.end()){
                     // if the the original variable already escaped, and is changed in between 
-                    if(inst_call->getCalledFunction()->getName() == cat_api[0]||inst_call->getCalledFunction()->getName() == cat_api[1]){                    
+                    if(is_cat_api(inst_call->getCalledFunction(), 0)||is_cat_api(inst_call->getCalledFunction(), 1)){                    
                       if(deps.depends(call,inst_call,false)){
                         const_reach = false;
                         break;
@@ -15,10 +15,86 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 #include <map>
+#include <chrono>
+#include <type_traits>
+#include "DataflowSolver.h"
 
 using namespace llvm;
 
+#define DEBUG_TYPE "CAT"
+
+STATISTIC(NumPropagatedReads, "Number of CAT_get_signed_value calls replaced by a value");
+STATISTIC(NumFoldedPhis, "Number of CAT phis folded to a constant");
+STATISTIC(NumSummaryHits, "Number of reads answered by a function summary");
+STATISTIC(NumIPCPArgs, "Number of reads of a CAT argument replaced by IPCP");
+STATISTIC(NumFixedPointIterations, "Number of block visits of the reaching definitions solver");
+STATISTIC(NumDependenceQueries, "Number of DependenceAnalysis queries");
+STATISTIC(NumFoldedOps, "Number of CAT_binary_add/sub calls folded away");
+STATISTIC(NumDeadOps, "Number of CAT calls erased because nothing reads their variable");
+STATISTIC(NumScalarReplacedCells, "Number of CAT variables replaced by i64 values");
+STATISTIC(NumHoistedReads, "Number of loop-invariant CAT_get_signed_value calls hoisted");
+STATISTIC(NumRedundantReads, "Number of CAT_get_signed_value calls replaced by an earlier read");
+STATISTIC(NumMissedReads, "Number of CAT_get_signed_value calls left in place");
+
+// the -CAT-profile counters are written to this file at exit by CatProfile.c;
+// under clang, giving it runs -CAT-profile after the CAT pass
+static cl::opt<std::string> CatProfile("cat-profile",
+  cl::desc("Profile file of the per-site counters of -CAT-profile"),
+  cl::value_desc("profile file"), cl::init("cat.prof"));
+
+// one JSON object per line for every CAT call site the pass transforms
+static cl::opt<std::string> CatRemarks("cat-remarks",
+  cl::desc("Write an optimization record per transformed CAT call site"),
+  cl::value_desc("file"), cl::init(""));
+
+// convergence telemetry of the reaching definitions solver, one record per
+// function it runs on
+static cl::opt<std::string> CatSolverStats("cat-solver-stats",
+  cl::desc("Write per-function fixed-point telemetry (CSV for *.csv, JSON lines otherwise)"),
+  cl::value_desc("file"), cl::init(""));
+
+// GEN/KILL/IN/OUT of every function the dense solver runs on, as lists of
+// instruction IDs; the text of each ID goes to <file>.sym
+static cl::opt<std::string> CatDumpSets("cat-dump-sets",
+  cl::desc("Dump the reaching definition sets as JSON lines of instruction IDs"),
+  cl::value_desc("file"), cl::init(""));
+
+// heap bytes held by each dataflow structure, per function, plus one
+// "(module)" record for the module-wide work lists and summaries
+static cl::opt<std::string> CatMemReport("cat-mem-report",
+  cl::desc("Write the bytes held by each dataflow structure per function (CSV for *.csv, JSON lines otherwise)"),
+  cl::value_desc("file"), cl::init(""));
+
+// a Chrome Trace Event timeline of the run: doInitialization, every
+// function, phase and fixed-point sweep
+static cl::opt<std::string> CatTrace("cat-trace",
+  cl::desc("Write a Chrome Trace Event timeline of the CAT pass"),
+  cl::value_desc("file"), cl::init(""));
+
+static cl::opt<unsigned> CatTraceEvents("cat-trace-events",
+  cl::desc("Events kept by -cat-trace; older ones are dropped"), cl::init(1 << 20));
+
+static cl::opt<bool> CatTimePhases("cat-time-phases",
+  cl::desc("Time the phases of the CAT pass, in total and per function"));
+
+// every CAT_get_signed_value left in place is also reported as a
+// -pass-remarks-missed=CAT remark and a -cat-remarks record with its reason
+static cl::opt<bool> CatMissedSummary("cat-missed-summary",
+  cl::desc("Print the CAT_get_signed_value calls left in place per missed-propagation reason"));
+
 namespace {
   // struct funcSum {
   //   // store the comparasion inst
@@ -27,13 +103,522 @@ namespace {
   //   std::vector<Value*> catV;
   // };
 
+  // CAT-SSA: each create/add/sub writing a CAT cell, and each phi placed at
+  // the dominance frontier of those writes, is one version of the cell
+  struct CatVersion {
+    // defining create/add/sub, NULL for a phi
+    Instruction* inst;
+    // block the phi is placed in
+    BasicBlock* block;
+    int cell;
+    // phi: one incoming version per predecessor edge
+    // add/sub: the versions of its two source operands
+    // -1 marks an undefined or untracked operand
+    std::vector<int> operands;
+    // phi: the predecessor of each operand
+    std::vector<BasicBlock*> preds;
+    // phis and add/subs that read this version
+    std::vector<int> users;
+    // CAT_get_signed_value calls that read this version
+    std::vector<CallInst*> reads;
+    // 0: not known yet, 1: constant value, 2: not a constant
+    int state;
+    int64_t value;
+    // also read by an add/sub into a cell CAT-SSA does not track
+    bool external;
+  };
+
+  struct CatSSA {
+    // tracked cells are the CAT_create_signed_value calls whose result only
+    // flows into CAT calls, so nothing else can alias or modify them
+    std::vector<Instruction*> cells;
+    std::map<Value*, int> cellMap;
+    std::vector<CatVersion> versions;
+  };
+
+  // the CAT API; a call is classified by the index of its callee in this
+  // table, so a new CAT operation only needs a new entry here
+  const char* const catApiNames[] = {
+    "CAT_binary_add",
+    "CAT_binary_sub",
+    "CAT_create_signed_value",
+    "CAT_get_signed_value",
+  };
+
+  // compile-time phases timed by -cat-time-phases
+  enum CatPhase {
+    PhaseSummaries,
+    PhaseIPCP,
+    PhaseCatSSA,
+    PhaseGenKill,
+    PhaseFixedPoint,
+    PhaseEscape,
+    PhaseDependence,
+    PhasePropagate,
+    PhaseDeadOps,
+    PhaseScalarReplace,
+    PhaseLoopHoist,
+    PhaseReadCSE,
+    NumPhases
+  };
+
+  const char* const catPhaseNames[NumPhases] = {
+    "function summaries",
+    "findSameArg/doPropagate",
+    "CAT-SSA",
+    "GEN/KILL",
+    "reaching definitions",
+    "escape scan",
+    "DependenceAnalysis queries",
+    "propagation (incl. dependence queries)",
+    "dead CAT operations",
+    "scalar replacement",
+    "loop-invariant reads",
+    "redundant reads",
+  };
+
+  // str as a JSON string literal, for the remarks, dumps and trace
+  void writeJSONString(raw_ostream &OS, StringRef str) {
+    OS << '"';
+    for (char c : str) {
+      if (c == '"' || c == '\\') {
+        OS << '\\' << c;
+      } else if ((unsigned char)c < 0x20) {
+        OS << format("\\u%04x", c);
+      } else {
+        OS << c;
+      }
+    }
+    OS << '"';
+  }
+
+  // str as a CSV field, quoted with doubled quotes (RFC 4180), for the
+  // solver statistics and memory reports
+  void writeCSVString(raw_ostream &OS, StringRef str) {
+    OS << '"';
+    for (char c : str) {
+      if (c == '"') {
+        OS << '"';
+      }
+      OS << c;
+    }
+    OS << '"';
+  }
+
+  // -cat-trace: begin/end events in a fixed-size ring buffer that drops the
+  // oldest events when it wraps; names are written out only at the end
+  class TraceBuffer {
+    struct Event {
+      uint64_t ts;
+      const char* name;
+      const Function* F;
+      // sweep number, -1 for none
+      int arg;
+      char ph;
+    };
+    std::vector<Event> events;
+    size_t next;
+    bool wrapped;
+    std::chrono::steady_clock::time_point start;
+  public:
+    explicit TraceBuffer(size_t capacity) : events(std::max<size_t>(capacity, 1)), next(0), wrapped(false), start(std::chrono::steady_clock::now()) {}
+    void record(char ph, const char* name, const Function* F = NULL, int arg = -1) {
+      Event &e = events[next];
+      e.ts = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      e.name = name;
+      e.F = F;
+      e.arg = arg;
+      e.ph = ph;
+      if (++next == events.size()) {
+        next = 0;
+        wrapped = true;
+      }
+    }
+    void write(raw_ostream &OS) const {
+      OS << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+      size_t first = wrapped ? next : 0, count = wrapped ? events.size() : next;
+      for (size_t i = 0; i < count; i++) {
+        const Event &e = events[(first + i) % events.size()];
+        OS << (i == 0 ? "" : ",\n") << "{\"name\":\"" << e.name << "\",\"cat\":\"CAT\",\"ph\":\"" << e.ph
+           << "\",\"ts\":" << format("%.3f", e.ts / 1000.0) << ",\"pid\":1,\"tid\":1";
+        if (e.F != NULL || e.arg != -1) {
+          OS << ",\"args\":{";
+          if (e.F != NULL) {
+            OS << "\"function\":";
+            writeJSONString(OS, e.F->getName());
+          }
+          if (e.arg != -1) {
+            OS << (e.F != NULL ? "," : "") << "\"sweep\":" << e.arg;
+          }
+          OS << "}";
+        }
+        OS << "}";
+      }
+      OS << "\n]}\n";
+    }
+  };
+
+  // what a phase reports to: the module-wide and per-function timers of
+  // -cat-time-phases and the -cat-trace buffer, each NULL when disabled
+  struct PhaseTimers {
+    Timer* total;
+    Timer* perFunction;
+    TraceBuffer* trace;
+    const char* name;
+    const Function* F;
+  };
+
+  // runs a phase from construction until stop() or the end of the scope;
+  // with neither -cat-time-phases nor -cat-trace this is free
+  class PhaseRegion {
+    PhaseTimers timers;
+  public:
+    PhaseRegion(const PhaseTimers &timers) : timers(timers) {
+      if (timers.total != NULL) {
+        timers.total->startTimer();
+      }
+      if (timers.perFunction != NULL) {
+        timers.perFunction->startTimer();
+      }
+      if (timers.trace != NULL) {
+        timers.trace->record('B', timers.name, timers.F);
+      }
+    }
+    ~PhaseRegion() {
+      stop();
+    }
+    void stop() {
+      if (timers.trace != NULL) {
+        timers.trace->record('E', timers.name, timers.F);
+        timers.trace = NULL;
+      }
+      if (timers.perFunction != NULL) {
+        timers.perFunction->stopTimer();
+        timers.perFunction = NULL;
+      }
+      if (timers.total != NULL) {
+        timers.total->stopTimer();
+        timers.total = NULL;
+      }
+    }
+  };
+
   struct CAT : public FunctionPass {
     static char ID;
     std::map<Function*, Value*> sumMap;
+    // CAT API declaration -> index in catApiNames, filled in doInitialization
+    DenseMap<const Function*, int> catApi;
     CAT() : FunctionPass(ID) {}
     std::set<Function*> funcWorkList;
     std::set<BasicBlock*> blockWorkList;
     std::set<Instruction*> instWorkList;
+    // -cat-time-phases: one timer per phase, and one per function and phase
+    std::unique_ptr<TimerGroup> phaseGroup, functionPhaseGroup;
+    std::vector<std::unique_ptr<Timer>> phaseTimers;
+    std::map<std::pair<Function*, int>, std::unique_ptr<Timer>> functionPhaseTimers;
+    // -cat-trace events, written in doFinalization
+    std::unique_ptr<TraceBuffer> trace;
+    PhaseTimers getPhaseTimers(int phase, Function* F = NULL) {
+      PhaseTimers timers = {NULL, NULL, trace.get(), catPhaseNames[phase], F};
+      if (!phaseGroup) {
+        return timers;
+      }
+      timers.total = phaseTimers[phase].get();
+      if (F != NULL) {
+        auto& timer = functionPhaseTimers[std::make_pair(F, phase)];
+        if (!timer) {
+          timer.reset(new Timer(F->getName().str() + ": " + catPhaseNames[phase], *functionPhaseGroup));
+        }
+        timers.perFunction = timer.get();
+      }
+      return timers;
+    }
+    // -cat-remarks and -cat-solver-stats output, open between
+    // doInitialization and doFinalization
+    std::unique_ptr<raw_fd_ostream> remarksOut, solverStatsOut;
+    bool solverStatsCSV = false;
+    // -cat-dump-sets: the set dump, its symbol table, and the slot tracker
+    // that numbers the module once for printing every instruction
+    std::unique_ptr<raw_fd_ostream> dumpOut, dumpSymOut;
+    std::unique_ptr<ModuleSlotTracker> slotTracker;
+    DenseMap<const Instruction*, unsigned> instIds;
+    // -cat-mem-report: output, and the structures of the current function
+    std::unique_ptr<raw_fd_ostream> memReportOut;
+    bool memReportCSV = false;
+    std::vector<std::pair<const char*, uint64_t>> memAccount;
+    // why each read of the current function was not propagated, and the
+    // module-wide number of reads left in place per reason
+    std::map<CallInst*, const char*> missedReasons;
+    std::map<std::string, unsigned> missedCounts;
+
+    // approximate heap bytes of the standard containers; a red-black tree
+    // node holds three links and a color next to its value
+    template <typename T>
+    static uint64_t containerBytes(const std::vector<T> &v) {
+      return v.capacity() * sizeof(T);
+    }
+    template <typename K>
+    static uint64_t containerBytes(const std::set<K> &s) {
+      return s.size() * (4 * sizeof(void*) + sizeof(K));
+    }
+    template <typename K, typename V>
+    static uint64_t containerBytes(const std::map<K, V> &m) {
+      return m.size() * (4 * sizeof(void*) + sizeof(std::pair<const K, V>));
+    }
+
+    // writes one record for the structures accounted since the last one
+    void writeMemReport(StringRef name) {
+      raw_ostream &OS = *memReportOut;
+      uint64_t total = 0;
+      if (!memReportCSV) {
+        OS << "{\"function\":";
+        writeJSONString(OS, name);
+      }
+      for (auto& item : memAccount) {
+        total += item.second;
+        if (memReportCSV) {
+          writeCSVString(OS, name);
+          OS << "," << item.first << "," << item.second << "\n";
+        } else {
+          OS << ",\"" << item.first << "\":" << item.second;
+        }
+      }
+      if (memReportCSV) {
+        writeCSVString(OS, name);
+        OS << ",total," << total << "\n";
+      } else {
+        OS << ",\"total\":" << total << "}\n";
+      }
+      memAccount.clear();
+    }
+
+    static raw_fd_ostream* openOutput(const std::string &path) {
+      std::error_code EC;
+      auto* OS = new raw_fd_ostream(path, EC, sys::fs::F_Text);
+      if (EC) {
+        errs() << "CAT: cannot open " << path << ": " << EC.message() << "\n";
+        delete OS;
+        return NULL;
+      }
+      return OS;
+    }
+
+    // the dump ID of I; the first use prints I into the symbol table
+    unsigned getInstId(Instruction* I) {
+      auto it = instIds.find(I);
+      if (it != instIds.end()) {
+        return it->second;
+      }
+      unsigned id = instIds.size();
+      instIds[I] = id;
+      raw_ostream &OS = *dumpSymOut;
+      std::string text;
+      raw_string_ostream textOS(text);
+      I->print(textOS, *slotTracker);
+      OS << "{\"id\":" << id << ",\"function\":";
+      writeJSONString(OS, I->getParent()->getParent()->getName());
+      OS << ",\"text\":";
+      writeJSONString(OS, StringRef(textOS.str()).ltrim());
+      OS << "}\n";
+      return id;
+    }
+
+    template <typename Range>
+    void dumpIdList(Range &&insts) {
+      raw_ostream &OS = *dumpOut;
+      OS << '[';
+      bool first = true;
+      for (auto* I : insts) {
+        OS << (first ? "" : ",") << getInstId(I);
+        first = false;
+      }
+      OS << ']';
+    }
+
+    template <typename DefSet>
+    void dumpDefSet(const DefSet &set, const std::vector<Instruction*> &defV) {
+      raw_ostream &OS = *dumpOut;
+      OS << '[';
+      bool first = true;
+      dataflow::LatticeTraits<DefSet>::forEach(set, [&](unsigned d) {
+        OS << (first ? "" : ",") << getInstId(defV[d]);
+        first = false;
+      });
+      OS << ']';
+    }
+
+    // one line per function: GEN/KILL/IN/OUT of every block (named by the
+    // ID of its first instruction), then the IN set of every read in order
+    template <typename Solver, typename Transfer, typename DefSet>
+    void dumpSets(Function &F, const Solver &solver, const Transfer &transfer, const std::vector<Instruction*> &defV, std::map<Instruction*, const DefSet*> &useInMap) {
+      raw_ostream &OS = *dumpOut;
+      OS << "{\"function\":";
+      writeJSONString(OS, F.getName());
+      OS << ",\"blocks\":[";
+      for (unsigned b = 0; b < solver.getNumBlocks(); b++) {
+        OS << (b == 0 ? "" : ",") << "{\"entry\":" << getInstId(&solver.getBlock(b)->front()) << ",\"gen\":";
+        dumpDefSet(transfer.gen[b], defV);
+        OS << ",\"kill\":";
+        dumpDefSet(transfer.kill[b], defV);
+        OS << ",\"in\":";
+        dumpDefSet(solver.getIn(b), defV);
+        OS << ",\"out\":";
+        dumpDefSet(solver.getOut(b), defV);
+        OS << '}';
+      }
+      OS << "],\"reads\":[";
+      bool first = true;
+      for (auto& B : F) {
+        for (auto& I : B) {
+          auto read = useInMap.find(&I);
+          if (read == useInMap.end()) {
+            continue;
+          }
+          OS << (first ? "" : ",") << "{\"inst\":" << getInstId(&I) << ",\"in\":";
+          dumpDefSet(*read->second, defV);
+          OS << '}';
+          first = false;
+        }
+      }
+      OS << "]}\n";
+    }
+
+    // the demand-driven queries only know the IN sets of the reads
+    void dumpReadSets(Function &F, std::map<Instruction*, std::vector<Instruction*>> &readInSets) {
+      raw_ostream &OS = *dumpOut;
+      OS << "{\"function\":";
+      writeJSONString(OS, F.getName());
+      OS << ",\"reads\":[";
+      bool first = true;
+      for (auto& B : F) {
+        for (auto& I : B) {
+          auto read = readInSets.find(&I);
+          if (read == readInSets.end()) {
+            continue;
+          }
+          OS << (first ? "" : ",") << "{\"inst\":" << getInstId(&I) << ",\"in\":";
+          dumpIdList(read->second);
+          OS << '}';
+          first = false;
+        }
+      }
+      OS << "]}\n";
+    }
+
+    // sweeps, re-evaluated blocks and instructions, and set comparisons of
+    // the solve, plus the size of the block IN sets it converged to
+    template <typename Solver>
+    void writeSolverStats(Function &F, const Solver &solver, unsigned numDefs, const char* lattice) {
+      const dataflow::SolverStats &stats = solver.getStats();
+      unsigned numInsts = 0, maxIn = 0;
+      uint64_t sumIn = 0;
+      for (unsigned b = 0; b < solver.getNumBlocks(); b++) {
+        numInsts += solver.getBlock(b)->size();
+        unsigned in = Solver::Traits::count(solver.getIn(b));
+        maxIn = std::max(maxIn, in);
+        sumIn += in;
+      }
+      double avgIn = solver.getNumBlocks() == 0 ? 0 : (double)sumIn / solver.getNumBlocks();
+      raw_ostream &OS = *solverStatsOut;
+      if (solverStatsCSV) {
+        writeCSVString(OS, F.getName());
+        OS << "," << lattice << "," << solver.getNumBlocks() << "," << numInsts << "," << numDefs
+           << "," << stats.sweeps << "," << stats.blockVisits << "," << stats.instVisits
+           << "," << maxIn << "," << format("%.2f", avgIn) << "," << stats.comparisons << "\n";
+        return;
+      }
+      OS << "{\"function\":";
+      writeJSONString(OS, F.getName());
+      OS << ",\"lattice\":\"" << lattice << "\",\"blocks\":" << solver.getNumBlocks()
+         << ",\"instructions\":" << numInsts << ",\"definitions\":" << numDefs
+         << ",\"sweeps\":" << stats.sweeps << ",\"block_visits\":" << stats.blockVisits
+         << ",\"inst_visits\":" << stats.instVisits << ",\"max_in\":" << maxIn
+         << ",\"avg_in\":" << format("%.2f", avgIn) << ",\"comparisons\":" << stats.comparisons << "}\n";
+    }
+
+    // a CAT_get_signed_value about to be replaced by value; how names the
+    // rule that proved it: cat-ssa, reaching-defs, phi, summary or ipcp
+    void recordPropagation(CallInst* read, Value* value, const char* how) {
+      NumPropagatedReads++;
+      if (!remarksOut) {
+        return;
+      }
+      raw_ostream &OS = *remarksOut;
+      OS << "{\"pass\":\"CAT\",\"name\":\"PropagatedRead\",\"how\":\"" << how << "\",\"function\":";
+      writeJSONString(OS, read->getParent()->getParent()->getName());
+      const DebugLoc &loc = read->getDebugLoc();
+      if (loc) {
+        OS << ",\"line\":" << loc.getLine() << ",\"column\":" << loc.getCol();
+      }
+      OS << ",\"value\":";
+      if (auto* c = dyn_cast<ConstantInt>(value)) {
+        OS << c->getSExtValue();
+      } else {
+        OS << "null";
+      }
+      OS << "}\n";
+    }
+
+    // reason codes of a read the pass gives up on:
+    //   argument, load, call-result: the CAT value comes from outside
+    //   non-uniform-phi: the phi merges different or unknown values
+    //   escaped: the variable is passed to or stored by other code
+    //   dependence: DependenceAnalysis cannot rule out an escaped write
+    //   add-sub-write: a CAT_binary_add/sub result reaches the read
+    //   non-constant-create: the reaching create has no constant argument
+    //   undefined, no-reaching-definition: no definition reaches the read
+    void noteMissed(CallInst* read, const char* reason) {
+      missedReasons[read] = reason;
+    }
+
+    // report every CAT_get_signed_value still in F with the last reason
+    // noted for it
+    void reportMissed(Function &F) {
+      for (auto& B : F) {
+        for (auto& I : B) {
+          auto* read = dyn_cast<CallInst>(&I);
+          if (read == NULL || getCatType(read->getCalledFunction()) != 3) {
+            continue;
+          }
+          auto it = missedReasons.find(read);
+          const char* reason = it == missedReasons.end() ? "unknown" : it->second;
+          NumMissedReads++;
+          missedCounts[reason]++;
+          emitOptimizationRemarkMissed(F.getContext(), DEBUG_TYPE, F, read->getDebugLoc(), "CAT_get_signed_value not propagated: " + Twine(reason));
+          if (!remarksOut) {
+            continue;
+          }
+          raw_ostream &OS = *remarksOut;
+          OS << "{\"pass\":\"CAT\",\"name\":\"MissedPropagation\",\"reason\":\"" << reason << "\",\"function\":";
+          writeJSONString(OS, F.getName());
+          const DebugLoc &loc = read->getDebugLoc();
+          if (loc) {
+            OS << ",\"line\":" << loc.getLine() << ",\"column\":" << loc.getCol();
+          }
+          OS << "}\n";
+        }
+      }
+      missedReasons.clear();
+    }
+
+    // a CAT_binary_add/sub about to be erased because its result, value, is
+    // known wherever it is read
+    void recordFoldedOperation(CallInst* op, int64_t value) {
+      if (!remarksOut) {
+        return;
+      }
+      raw_ostream &OS = *remarksOut;
+      OS << "{\"pass\":\"CAT\",\"name\":\"FoldedOperation\",\"callee\":";
+      writeJSONString(OS, op->getCalledFunction()->getName());
+      OS << ",\"function\":";
+      writeJSONString(OS, op->getParent()->getParent()->getName());
+      const DebugLoc &loc = op->getDebugLoc();
+      if (loc) {
+        OS << ",\"line\":" << loc.getLine() << ",\"column\":" << loc.getCol();
+      }
+      OS << ",\"value\":" << value << "}\n";
+    }
+
     std::pair<bool, std::vector<Value*>> funcPhiNodeHelper(PHINode* node) {
       bool flag = true;
       std::vector<Value*> v;
@@ -55,19 +640,67 @@ namespace {
     // This function is invoked once at the initialization phase of the compiler    
     bool doInitialization (Module &M) override {
       //errs() << "CATPass: doInitialization for \"" << M.getName() <<"\"\n";
+      if (CatTimePhases && !phaseGroup) {
+        phaseGroup.reset(new TimerGroup("CAT pass phases"));
+        functionPhaseGroup.reset(new TimerGroup("CAT pass phases per function"));
+        for (int i = 0; i < NumPhases; i++) {
+          phaseTimers.push_back(std::unique_ptr<Timer>(new Timer(catPhaseNames[i], *phaseGroup)));
+        }
+      }
+      if (!CatRemarks.empty() && !remarksOut) {
+        remarksOut.reset(openOutput(CatRemarks));
+      }
+      if (!CatDumpSets.empty() && !dumpOut) {
+        dumpOut.reset(openOutput(CatDumpSets));
+        dumpSymOut.reset(openOutput(CatDumpSets + ".sym"));
+        if (!dumpOut || !dumpSymOut) {
+          dumpOut.reset();
+          dumpSymOut.reset();
+        } else {
+          slotTracker.reset(new ModuleSlotTracker(&M, false));
+        }
+      }
+      if (!CatMemReport.empty() && !memReportOut) {
+        memReportOut.reset(openOutput(CatMemReport));
+        memReportCSV = StringRef(CatMemReport).endswith(".csv");
+        if (memReportOut && memReportCSV) {
+          *memReportOut << "function,structure,bytes\n";
+        }
+      }
+      if (!CatSolverStats.empty() && !solverStatsOut) {
+        solverStatsOut.reset(openOutput(CatSolverStats));
+        solverStatsCSV = StringRef(CatSolverStats).endswith(".csv");
+        if (solverStatsOut && solverStatsCSV) {
+          *solverStatsOut << "function,lattice,blocks,instructions,definitions,sweeps,block_visits,inst_visits,max_in,avg_in,comparisons\n";
+        }
+      }
+      if (!CatTrace.empty() && !trace) {
+        trace.reset(new TraceBuffer(CatTraceEvents));
+      }
+      if (trace) {
+        trace->record('B', "doInitialization");
+      }
+      PhaseRegion summaries(getPhaseTimers(PhaseSummaries));
+      // resolve the CAT API declarations once; from here on classifying a
+      // call is a pointer lookup, and their use lists give the work lists
+      catApi.clear();
+      for (int i = 0; i < sizeof(catApiNames) / sizeof(catApiNames[0]); i++) {
+        Function* api = M.getFunction(catApiNames[i]);
+        if (api == NULL) {
+          continue;
+        }
+        catApi[api] = i;
+        for (auto user : api->users()) {
+          // errs() << "user: " << *user << " of function is: " << api->getName() << "\n";
+          if (auto* tempInst = dyn_cast<CallInst>(user)) {
+            funcWorkList.insert(tempInst->getParent()->getParent());
+            blockWorkList.insert(tempInst->getParent());
+            instWorkList.insert(tempInst);
+          }
+        }
+      }
       for (auto &F : M) {
         if (F.getName() != "main" && !F.isDeclaration()){
-          if (getCatType(&F) != -1) {
-            for (auto user : F.users()) {
-              // errs() << "user: " << *user << " of function is: " << F.getName() << "\n";
-              if (auto* tempInst = dyn_cast<CallInst>(user)) {
-                funcWorkList.insert(tempInst->getParent()->getParent());
-                blockWorkList.insert(tempInst->getParent());
-                instWorkList.insert(tempInst);
-              }
-            }
-          }
-          
           for (auto &B : F){
             for (auto &I : B){
               if(auto* retnInst = dyn_cast<ReturnInst>(&I)){
@@ -113,72 +746,77 @@ namespace {
           }          
         }
       }
-      findSameArg(M);
+      summaries.stop();
+      {
+        PhaseRegion ipcp(getPhaseTimers(PhaseIPCP));
+        findSameArg(M);
+      }
+      if (memReportOut) {
+        memAccount.push_back(std::make_pair("funcWorkList", containerBytes(funcWorkList)));
+        memAccount.push_back(std::make_pair("blockWorkList", containerBytes(blockWorkList)));
+        memAccount.push_back(std::make_pair("instWorkList", containerBytes(instWorkList)));
+        memAccount.push_back(std::make_pair("sumMap", containerBytes(sumMap)));
+        memAccount.push_back(std::make_pair("catApi", (uint64_t)catApi.getMemorySize()));
+        writeMemReport("(module)");
+      }
+      if (trace) {
+        trace->record('E', "doInitialization");
+      }
       return true;
     }
 
+    bool doFinalization (Module &M) override {
+      if (remarksOut && !missedCounts.empty()) {
+        raw_ostream &OS = *remarksOut;
+        OS << "{\"pass\":\"CAT\",\"name\":\"MissedSummary\",\"reasons\":{";
+        for (auto it = missedCounts.begin(); it != missedCounts.end(); ++it) {
+          OS << (it == missedCounts.begin() ? "" : ",") << '"' << it->first << "\":" << it->second;
+        }
+        OS << "}}\n";
+      }
+      if (CatMissedSummary) {
+        errs() << "CAT reads left in place per reason:\n";
+        for (auto& count : missedCounts) {
+          errs() << format("  %-24s %u\n", count.first.c_str(), count.second);
+        }
+      }
+      missedCounts.clear();
+      remarksOut.reset();
+      solverStatsOut.reset();
+      memReportOut.reset();
+      dumpOut.reset();
+      dumpSymOut.reset();
+      slotTracker.reset();
+      instIds.clear();
+      if (trace) {
+        std::unique_ptr<raw_fd_ostream> traceOut(openOutput(CatTrace));
+        if (traceOut) {
+          trace->write(*traceOut);
+        }
+        trace.reset();
+      }
+      if (phaseGroup) {
+        phaseGroup->print(errs());
+        functionPhaseGroup->print(errs());
+        functionPhaseTimers.clear();
+        phaseTimers.clear();
+        functionPhaseGroup.reset();
+        phaseGroup.reset();
+      }
+      return false;
+    }
+
     // This function is invoked once per function compiled
     // The LLVM IR of the input functions is ready and it can be analyzed and/or transformed
 
 // function to help distinguishing CAT function
+// the index of callee in catApiNames, -1 for any other (or indirect) callee
     int getCatType(Function* callee) const{
-      std::string funcName = callee->getName();
-      if (funcName == "CAT_binary_add")
-        return 0;
-      if (funcName == "CAT_binary_sub")
-        return 1;
-      if (funcName == "CAT_create_signed_value")
-        return 2;
-      if (funcName == "CAT_get_signed_value")
-        return 3;
-      return -1;
-    }
-
-// function to generate gen & kill set for one instruction, return a pair of sets
-    std::pair<std::set<Instruction*>, std::set<Instruction*>> getGenKillPair(Instruction &I) {
-      std::set<Instruction*> genSet;
-      std::set<Instruction*> killSet;
-      if (auto* call = dyn_cast<CallInst>(&I)) {
-        // Function* callee;
-        // callee = call->getCalledFunction();
-        switch(getCatType(call->getCalledFunction())) {
-          case 0:
-          case 1: genSet.insert(&I);
-          if (auto* subIns = dyn_cast<Instruction>(call->getArgOperand(0))) {
-            killSet.insert(subIns);
-            for (auto user : subIns->users()) {
-              if (auto* i = dyn_cast<CallInst>(user)) {
-                if (getCatType(i->getCalledFunction()) != -1 && getCatType(i->getCalledFunction()) != 3) {
-                  auto* subsub = dyn_cast<Instruction>(i->getArgOperand(0));
-                  if (&I == subIns || &I == subsub || subIns == subsub) {
-                    killSet.insert(i);
-                  }
-                }
-              }
-            }
-            if (killSet.find(&I) !=killSet.end()) {
-              killSet.erase(&I);
-            }
-          }
-          break;
-          case 2: genSet.insert(&I);
-          for (auto U : I.users()) {
-            if (auto* i = dyn_cast<CallInst>(U)) {
-              if (getCatType(i->getCalledFunction()) != -1 && getCatType(i->getCalledFunction()) != 3) {
-                              //errs() << "type is :" << i->getType() << "\n";
-                auto* subIns = dyn_cast<Instruction>(i->getArgOperand(0));
-                if (&I == subIns) {
-                  killSet.insert(i);
-                }
-              }
-            }
-          }
-          break;
-          case 3:
-          default: break;
-        }
+      auto it = catApi.find(callee);
+      if (it == catApi.end()) {
+        return -1;
       }
-      return std::make_pair(genSet, killSet);
+      return it->second;
     }
 
     // void printSets(Function &F, std::vector<Instruction *> insV, std::vector<std::set<Instruction *>> sets1, std::vector<std::set<Instruction *>> sets2, std::string s1, std::string s2) {
@@ -198,53 +836,90 @@ namespace {
     //   }
     // }
 
+    // whether the cell behind a CAT value is only ever read: every use is a
+    // CAT_get_signed_value, a source of an add/sub, or a phi whose own uses
+    // are only reads too
+    bool catValueIsReadOnly(Value* value, std::set<Value*> &visited) {
+      if (!visited.insert(value).second) {
+        return true;
+      }
+      for (auto& U : value->uses()) {
+        if (auto* phi = dyn_cast<PHINode>(U.getUser())) {
+          if (!catValueIsReadOnly(phi, visited)) {
+            return false;
+          }
+          continue;
+        }
+        auto* call = dyn_cast<CallInst>(U.getUser());
+        if (call == NULL || U.getOperandNo() >= call->getNumArgOperands()) {
+          return false;
+        }
+        int catType = getCatType(call->getCalledFunction());
+        if (catType != 3 && !(catType <= 1 && catType != -1 && U.getOperandNo() > 0)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
     // deal phinode and nested phinode
     // return pair of flag and preValue
-    // right now works, just do not do (nested) propagate inside this function
+    // every incoming value must be a create of the same constant, and no
+    // cell merged by the phi may be written or escape, so the value read
+    // through the phi is that constant
     std::pair<bool, int64_t> phiNodeHelper(PHINode* node) {
+      std::set<PHINode*> phis;
+      std::set<Value*> readOnly;
+      return phiNodeHelper(node, phis, readOnly);
+    }
+
+    std::pair<bool, int64_t> phiNodeHelper(PHINode* node, std::set<PHINode*> &phis, std::set<Value*> &readOnly) {
       bool flag = true;
       int64_t preValue = 0;
-      Instruction* fromInst;
+      bool hasValue = false;
+      // a phi on a cycle adds no new incoming value
+      if (!phis.insert(node).second) {
+        return std::make_pair(true, preValue);
+      }
       for (int i = 0; i < node->getNumIncomingValues(); i++) {
         auto nodeValue = node->getIncomingValue(i);
-        // escape if from argument
-        if (isa<Argument>(nodeValue)) {
-          flag = false;
-          break;
-        } else if (isa<PHINode>(nodeValue)) {
+        int64_t value;
+        if (isa<PHINode>(nodeValue)) {
           // if a phinode inside a phinode
-
-          auto boolIntPair = phiNodeHelper(cast<PHINode>(nodeValue));
+          bool seen = phis.find(cast<PHINode>(nodeValue)) != phis.end();
+          auto boolIntPair = phiNodeHelper(cast<PHINode>(nodeValue), phis, readOnly);
           // if inside phinode cannot do constant propagation, this neighter
           if (!boolIntPair.first) {
             flag = false;
             break;
-          } 
-          // if inside phinode value is not the same as preValue
-          if (preValue != boolIntPair.second && i != 0) {
+          }
+          if (seen) {
+            continue;
+          }
+          value = boolIntPair.second;
+        } else {
+          // escape if from argument, load or any other value than a create
+          auto* nodeInst = dyn_cast<CallInst>(nodeValue);
+          if (nodeInst == NULL || getCatType(nodeInst->getCalledFunction()) != 2) {
+            flag = false;
+            break;
+          }
+          auto* constPtr = dyn_cast<ConstantInt>(nodeInst->getArgOperand(0));
+          if (constPtr == NULL || !catValueIsReadOnly(nodeInst, readOnly)) {
             flag = false;
             break;
-          } else {
-            preValue = boolIntPair.second;
-          }
-        } 
-        else {
-          auto nodeInst = dyn_cast<CallInst>(nodeValue);
-          if (auto opValue = nodeInst->getArgOperand(0)) {
-            if (auto constPtr = dyn_cast<ConstantInt>(opValue)) {
-              if (i == 0) {
-                preValue = constPtr->getSExtValue();
-              } else {
-                if (preValue != constPtr->getSExtValue()) {
-                  flag = false;
-                  break;
-                }
-              }
-            }
           }
+          value = constPtr->getSExtValue();
         }
+        // if the value is not the same as preValue
+        if (hasValue && preValue != value) {
+          flag = false;
+          break;
+        }
+        preValue = value;
+        hasValue = true;
       }
-      return std::make_pair(flag, preValue);
+      return std::make_pair(flag && hasValue, preValue);
     }
 
     // <result> = icmp <cond> <ty> <op1>, <op2>   ; yields i1 or <N x i1>:result
@@ -320,6 +995,8 @@ namespace {
         if (auto* callInst = dyn_cast<CallInst>(inst)) {
           if (getCatType(callInst->getCalledFunction()) == 3) {
             if (isa<Argument>(callInst->getArgOperand(0))) {
+              NumIPCPArgs++;
+              recordPropagation(callInst, argValue, "ipcp");
               auto* b = inst->getParent();
               BasicBlock::iterator ii(inst);
               ReplaceInstWithValue(b->getInstList(), ii, argValue);
@@ -339,161 +1016,1227 @@ namespace {
       return modified;
     }
 
-    bool runOnFunction (Function &F) override {
-      //errs() << "Hello LLVM World at \"runOnFunction\"\n" ;
-      bool modified = false;
-      if (F.isDeclaration() || funcWorkList.find(&F) == funcWorkList.end()) {
-        return modified;
+    // turn a set of definition numbers back into the defining instructions
+    template <typename DefSet>
+    static std::vector<Instruction*> expandDefSet(const DefSet &defSet, const std::vector<Instruction*> &defV) {
+      std::vector<Instruction*> v;
+      dataflow::LatticeTraits<DefSet>::forEach(defSet, [&](unsigned i) {
+        v.push_back(defV[i]);
+      });
+      return v;
+    }
+
+    // functions with at least this many definitions per read answer the
+    // reads with demand-driven queries instead of the exhaustive solver
+    static const int DefsPerDemandQuery = 4;
+
+    // the definitions of variable var reaching the entry of B: walk the
+    // predecessors backward, stopping at blocks that write var (their last
+    // write reaches) or whose answer is already memoized in entryDefs
+    const std::vector<int> &defsAtEntry(BasicBlock* B, int var, std::map<std::pair<BasicBlock*, int>, int> &lastDef, std::map<std::pair<BasicBlock*, int>, std::vector<int>> &entryDefs) {
+      auto key = std::make_pair(B, var);
+      auto memo = entryDefs.find(key);
+      if (memo != entryDefs.end()) {
+        return memo->second;
       }
-      // errs()<< F.getName() << " in work list!\n";
-      std::vector<Instruction *> insV;
-      std::vector<std::set<Instruction *>> genMap, killMap, inMap, outMap;
-      // std::vector<std::set<Instruction *>> genMap;
-      // std::vector<std::set<Instruction *>> killMap;
-      // std::map<int, std::set<Instruction *>> genMap;
-      // std::map<int, std::set<Instruction *>> killMap;
-      // std::vector<std::set<Instruction *>> inMap;
-      // std::vector<std::set<Instruction *>> outMap;
-      // std::map<int, std::set<Instruction *>> inMap;
-      // std::map<int, std::set<Instruction *>> outMap;
-      std::map<Instruction*, int> instMap;
-      int indexValue = 0;
+      std::set<int> defs;
+      std::set<BasicBlock*> visited;
+      std::vector<BasicBlock*> workList(pred_begin(B), pred_end(B));
+      while (!workList.empty()) {
+        auto* P = workList.back();
+        workList.pop_back();
+        if (!visited.insert(P).second) {
+          continue;
+        }
+        auto last = lastDef.find(std::make_pair(P, var));
+        if (last != lastDef.end()) {
+          defs.insert(last->second);
+          continue;
+        }
+        auto known = entryDefs.find(std::make_pair(P, var));
+        if (known != entryDefs.end()) {
+          defs.insert(known->second.begin(), known->second.end());
+          continue;
+        }
+        workList.insert(workList.end(), pred_begin(P), pred_end(P));
+      }
+      auto& result = entryDefs[key];
+      result.assign(defs.begin(), defs.end());
+      return result;
+    }
+
+    // demand-driven reaching definitions: for every CAT_get_signed_value,
+    // the definitions of its own variable that reach it
+    void queryReachingDefs(Function &F, std::vector<Instruction*> &defV, std::map<Instruction*, int> &defMap, std::vector<int> &defVar, std::map<Value*, int> &varMap, std::map<Instruction*, std::vector<Instruction*>> &readInSets) {
+      // defs are numbered in layout order, so the last one numbered wins
+      std::map<std::pair<BasicBlock*, int>, int> lastDef;
+      for (int d = 0; d < defV.size(); d++) {
+        lastDef[std::make_pair(defV[d]->getParent(), defVar[d])] = d;
+      }
+      std::map<std::pair<BasicBlock*, int>, std::vector<int>> entryDefs;
       for (auto& B : F) {
+        // the latest definition of each variable seen so far in B
+        std::map<int, int> localDef;
         for (auto& I : B) {
-         insV.push_back(&I);
-          instMap[&I] = indexValue;
-          auto genKillPair = getGenKillPair(I);
-          genMap.push_back(genKillPair.first);
-          killMap.push_back(genKillPair.second);
-          outMap.push_back(genKillPair.first);
-          inMap.push_back(std::set<Instruction *>());
-          // genMap[indexValue] = genKillPair.first;
-          // killMap[indexValue] = genKillPair.second;
-          // initial outset for each instruction
-          // outMap[indexValue] = std::set<Instruction *>();
-          // inMap[indexValue] = std::set<Instruction *>();
-          indexValue++;
-        }
-      }
-      // need a faster approach to deal with in and out set
-      // trying replace set and vector by using map, not working
-      bool change=true, firstTime=true, blockReworkFlag=false;
-      while(change) {
-        int insIndex = 0;
-        change = false;
-        for (auto& B : F) {
-          int blkCount = 0;
-          blockReworkFlag = false;
-          if (!firstTime && blockWorkList.find(&B) == blockWorkList.end()) {
+          auto it = defMap.find(&I);
+          if (it != defMap.end()) {
+            localDef[defVar[it->second]] = it->second;
             continue;
           }
-          for (auto& I : B) {
-            if (!firstTime && instWorkList.find(&I) == instWorkList.end()) {
-                continue;
-            }
-            // inset
-            // tempInSet
-            std::set<Instruction *>* tempInSetPtr = &inMap[insIndex];
-            // if it is the first instruction of all the program, no inset
-            if (insIndex != 0) {
-              // if it is the first instruction of a basic block,
-              // the in set should be all predecesor block's last instruction
-              if (blkCount == 0) {
-                for (auto PI = pred_begin(&B), E = pred_end(&B); PI != E; ++PI) {
-                  BasicBlock *Pred = *PI;
-                  if (Pred != NULL) {
-                    auto preIn = Pred->getTerminator();
-                    if (preIn != NULL) {
-                      // int preinsIndex = std::find(insV.begin(), insV.end(), preIn) - insV.begin();
-                      int preinsIndex = instMap[preIn];
-                      // inMap[insIndex].insert(outMap[preinsIndex].begin(), outMap[preinsIndex].end());
-                      tempInSetPtr->insert(outMap[preinsIndex].begin(), outMap[preinsIndex].end());
-                    }
-                  }
-                }
-              } else {
-                *tempInSetPtr = outMap[insIndex-1];
-                // inMap[insIndex].clear();
-                // inMap[insIndex].insert(outMap[insIndex-1].begin(), outMap[insIndex-1].end());
-              }
-            }
-            // inMap[insIndex] = tempInSet;
-            // inMap[insIndex] = tempInSet;
-            // outset
-            std::set<Instruction *> tempOutSet = genMap[insIndex];
-            // tempOutSet.insert(genMap[insIndex].begin(), genMap[insIndex].end());
-            std::set_difference(tempInSetPtr->begin(), tempInSetPtr->end(), killMap[insIndex].begin(), killMap[insIndex].end(), std::inserter(tempOutSet, tempOutSet.end()));
-            if (tempOutSet != outMap[insIndex]) {
-              change = true;
-              // outMap[insIndex].clear();
-              // outMap[insIndex].insert(tempOutSet.begin(), tempOutSet.end());
-              outMap[insIndex] = tempOutSet;
-              blockReworkFlag = true;
-            }
-            // index value
-            blkCount++;
-            insIndex++;
-          }
-          if (!blockReworkFlag) {
-            // if (blockWorkList.find(&B) != blockWorkList.end()) {
-            //   errs() << B << "enhanced\n" ;
-            // }
-            blockWorkList.erase(&B);
-          } 
-        }
-        firstTime = false;
-      }
-      // constant propagation with data dependence
-      // H4 starts here
-      // modified to H7 version
-      DependenceAnalysis &deps = getAnalysis<DependenceAnalysis>();
-      std::set<Instruction*> escapeSet, escapeSetSpecific;
-      for (int i = 0; i < insV.size(); i++) {
-        // for every cat value get pointed, recognized as escaping
-        if (auto* ptrInst = dyn_cast<StoreInst>(insV[i])) {
-          if (auto* escapeInst = dyn_cast<Instruction>(ptrInst->getValueOperand())) {
-            escapeSet.insert(escapeInst);
+          auto* call = dyn_cast<CallInst>(&I);
+          if (call == NULL || getCatType(call->getCalledFunction()) != 3) {
+            continue;
           }
-        }
-        if (auto* tempInst= dyn_cast<CallInst>(insV[i])) {
-          if (tempInst->getNumArgOperands() > 0) {
-            if (getCatType(tempInst->getCalledFunction()) == -1) {
-              if (auto* escapeInst = dyn_cast<CallInst>(tempInst->getArgOperand(0))) {
-                if (getCatType(escapeInst->getCalledFunction()) == 2) {
-                  escapeSet.insert(escapeInst);
-                }
-              }
-              for (int j = 0; j < tempInst->getNumArgOperands(); j++) {
-                if (auto* escapeInst = dyn_cast<CallInst>(tempInst->getArgOperand(j))) {
-                  if (getCatType(escapeInst->getCalledFunction()) == 2) {
-                    escapeSetSpecific.insert(escapeInst);
-                    // errs()<< *escapeInst <<  "\n";
-                  }
-                }
-              }
-            }
+          auto& inSet = readInSets[call];
+          auto var = varMap.find(call->getArgOperand(0));
+          if (var == varMap.end()) {
+            continue;
+          }
+          auto local = localDef.find(var->second);
+          if (local != localDef.end()) {
+            inSet.push_back(defV[local->second]);
+            continue;
+          }
+          for (auto d : defsAtEntry(&B, var->second, lastDef, entryDefs)) {
+            inSet.push_back(defV[d]);
           }
         }
       }
-      for(int i = 0; i < insV.size(); i++) {
-        if (auto* call = dyn_cast<CallInst>(insV[i])) {
-          Function* callee = call->getCalledFunction();
-          // if from get_signed_value
+    }
+
+    // functions whose dense IN/OUT matrix (blocks x definitions) would take
+    // more bits than this use the sparse representation instead
+    static const uint64_t DenseBitLimit = 1ULL << 26;
+
+    // a create is versioned only when every use of it is an operand of a
+    // CAT call, i.e. it is never stored, passed, returned or merged
+    bool isTrackedCell(Instruction* create) {
+      for (auto& U : create->uses()) {
+        auto* call = dyn_cast<CallInst>(U.getUser());
+        if (call == NULL || call->getCalledFunction() == NULL) {
+          return false;
+        }
+        int catType = getCatType(call->getCalledFunction());
+        if (catType == -1 || catType == 2 || U.getOperandNo() >= call->getNumArgOperands()) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    int newCatVersion(CatSSA &ssa, int cell, Instruction* inst, BasicBlock* block) {
+      CatVersion version;
+      version.inst = inst;
+      version.block = block;
+      version.cell = cell;
+      version.state = 0;
+      version.value = 0;
+      version.external = false;
+      ssa.versions.push_back(version);
+      return ssa.versions.size() - 1;
+    }
+
+    bool isCatCreate(const CatVersion &version) {
+      return version.inst != NULL && getCatType(cast<CallInst>(version.inst)->getCalledFunction()) == 2;
+    }
+
+    // build CAT-SSA for the tracked cells of F: phis go on the iterated
+    // dominance frontier of each cell's writes, then one dominator tree walk
+    // links every read to the version reaching it
+    void buildCatSSA(Function &F, DominatorTree &DT, CatSSA &ssa) {
+      std::map<BasicBlock*, std::vector<Instruction*>> blockOps;
+      for (auto& B : F) {
+        if (!DT.isReachableFromEntry(&B)) {
+          continue;
+        }
+        for (auto& I : B) {
+          if (auto* call = dyn_cast<CallInst>(&I)) {
+            if (call->getCalledFunction() != NULL && getCatType(call->getCalledFunction()) == 2 && isTrackedCell(call)) {
+              ssa.cellMap[call] = ssa.cells.size();
+              ssa.cells.push_back(call);
+            }
+          }
+        }
+      }
+      if (ssa.cells.empty()) {
+        return;
+      }
+      // blocks writing each cell, and the CAT calls of every block touching a cell
+      std::vector<std::set<BasicBlock*>> defBlocks(ssa.cells.size());
+      for (int c = 0; c < ssa.cells.size(); c++) {
+        defBlocks[c].insert(ssa.cells[c]->getParent());
+        blockOps[ssa.cells[c]->getParent()];
+        for (auto& U : ssa.cells[c]->uses()) {
+          auto* call = cast<CallInst>(U.getUser());
+          if (!DT.isReachableFromEntry(call->getParent())) {
+            continue;
+          }
+          blockOps[call->getParent()];
+          if (U.getOperandNo() == 0 && getCatType(call->getCalledFunction()) <= 1) {
+            defBlocks[c].insert(call->getParent());
+          }
+        }
+      }
+      for (auto& blockOp : blockOps) {
+        for (auto& I : *blockOp.first) {
+          if (auto* call = dyn_cast<CallInst>(&I)) {
+            if (call->getCalledFunction() != NULL && getCatType(call->getCalledFunction()) != -1) {
+              blockOp.second.push_back(call);
+            }
+          }
+        }
+      }
+      // dominance frontiers (Cytron et al.): walk up from every predecessor
+      // of a join block until its immediate dominator
+      std::map<BasicBlock*, std::set<BasicBlock*>> domFrontier;
+      for (auto& B : F) {
+        if (!DT.isReachableFromEntry(&B) || B.getSinglePredecessor() != NULL) {
+          continue;
+        }
+        auto* idom = DT.getNode(&B)->getIDom();
+        for (auto PI = pred_begin(&B), E = pred_end(&B); PI != E; ++PI) {
+          if (!DT.isReachableFromEntry(*PI)) {
+            continue;
+          }
+          for (auto* runner = DT.getNode(*PI); runner != idom; runner = runner->getIDom()) {
+            domFrontier[runner->getBlock()].insert(&B);
+          }
+        }
+      }
+      // phi placement on the iterated dominance frontier
+      std::map<BasicBlock*, std::vector<int>> blockPhis;
+      for (int c = 0; c < ssa.cells.size(); c++) {
+        std::set<BasicBlock*> hasPhi;
+        std::vector<BasicBlock*> workList(defBlocks[c].begin(), defBlocks[c].end());
+        while (!workList.empty()) {
+          auto* B = workList.back();
+          workList.pop_back();
+          for (auto* frontier : domFrontier[B]) {
+            if (hasPhi.insert(frontier).second) {
+              blockPhis[frontier].push_back(newCatVersion(ssa, c, NULL, frontier));
+              if (defBlocks[c].find(frontier) == defBlocks[c].end()) {
+                workList.push_back(frontier);
+              }
+            }
+          }
+        }
+      }
+      // renaming: one version stack per cell, walked over the dominator tree
+      std::vector<std::vector<int>> stacks(ssa.cells.size());
+      auto topVersion = [&](Value* value) {
+        auto it = ssa.cellMap.find(value);
+        if (it == ssa.cellMap.end() || stacks[it->second].empty()) {
+          return -1;
+        }
+        return stacks[it->second].back();
+      };
+      std::vector<std::pair<DomTreeNode*, bool>> walk;
+      walk.push_back(std::make_pair(DT.getRootNode(), false));
+      std::map<BasicBlock*, std::vector<int>> pushed;
+      while (!walk.empty()) {
+        auto* node = walk.back().first;
+        bool leaving = walk.back().second;
+        walk.pop_back();
+        auto* B = node->getBlock();
+        if (leaving) {
+          for (auto c : pushed[B]) {
+            stacks[c].pop_back();
+          }
+          pushed.erase(B);
+          continue;
+        }
+        for (auto v : blockPhis[B]) {
+          stacks[ssa.versions[v].cell].push_back(v);
+          pushed[B].push_back(ssa.versions[v].cell);
+        }
+        auto ops = blockOps.find(B);
+        if (ops != blockOps.end()) {
+          for (auto* I : ops->second) {
+            auto* call = cast<CallInst>(I);
+            switch (getCatType(call->getCalledFunction())) {
+              case 0:
+              case 1: {
+                int v = -1;
+                auto it = ssa.cellMap.find(call->getArgOperand(0));
+                if (it != ssa.cellMap.end()) {
+                  v = newCatVersion(ssa, it->second, call, B);
+                }
+                for (int j = 1; j <= 2; j++) {
+                  int operand = topVersion(call->getArgOperand(j));
+                  if (v != -1) {
+                    ssa.versions[v].operands.push_back(operand);
+                    if (operand != -1) {
+                      ssa.versions[operand].users.push_back(v);
+                    }
+                  } else if (operand != -1) {
+                    ssa.versions[operand].external = true;
+                  }
+                }
+                if (v != -1) {
+                  stacks[it->second].push_back(v);
+                  pushed[B].push_back(it->second);
+                }
+                break;
+              }
+              case 2: {
+                auto it = ssa.cellMap.find(call);
+                if (it != ssa.cellMap.end()) {
+                  int v = newCatVersion(ssa, it->second, call, B);
+                  if (auto* c = dyn_cast<ConstantInt>(call->getArgOperand(0))) {
+                    ssa.versions[v].state = 1;
+                    ssa.versions[v].value = c->getSExtValue();
+                  } else {
+                    ssa.versions[v].state = 2;
+                  }
+                  stacks[it->second].push_back(v);
+                  pushed[B].push_back(it->second);
+                }
+                break;
+              }
+              case 3: {
+                int v = topVersion(call->getArgOperand(0));
+                if (v != -1) {
+                  ssa.versions[v].reads.push_back(call);
+                }
+                break;
+              }
+              default: break;
+            }
+          }
+        }
+        for (auto SI = succ_begin(B), E = succ_end(B); SI != E; ++SI) {
+          auto phis = blockPhis.find(*SI);
+          if (phis == blockPhis.end()) {
+            continue;
+          }
+          for (auto v : phis->second) {
+            int operand = stacks[ssa.versions[v].cell].empty() ? -1 : stacks[ssa.versions[v].cell].back();
+            ssa.versions[v].operands.push_back(operand);
+            ssa.versions[v].preds.push_back(B);
+            if (operand != -1) {
+              ssa.versions[operand].users.push_back(v);
+            }
+          }
+        }
+        walk.push_back(std::make_pair(node, true));
+        for (auto* child : *node) {
+          walk.push_back(std::make_pair(child, false));
+        }
+      }
+    }
+
+    // sparse constant propagation over the CAT-SSA def-use chains, then fold
+    // every CAT_get_signed_value whose version is a known constant, and drop
+    // the constant add/subs nothing reads at run time any more
+    bool propagateCatSSA(CatSSA &ssa) {
+      bool modified = false;
+      std::vector<int> workList;
+      for (int v = 0; v < ssa.versions.size(); v++) {
+        if (!isCatCreate(ssa.versions[v])) {
+          workList.push_back(v);
+        }
+      }
+      while (!workList.empty()) {
+        int v = workList.back();
+        workList.pop_back();
+        auto& version = ssa.versions[v];
+        if (isCatCreate(version) || version.state == 2) {
+          continue;
+        }
+        int state = 0;
+        int64_t value = 0;
+        if (version.inst == NULL) {
+          // meet over the incoming versions; undefined and unknown ones are skipped
+          for (auto operand : version.operands) {
+            if (operand == -1 || ssa.versions[operand].state == 0) {
+              continue;
+            }
+            auto& incoming = ssa.versions[operand];
+            if (incoming.state == 2 || (state == 1 && value != incoming.value)) {
+              state = 2;
+              break;
+            }
+            state = 1;
+            value = incoming.value;
+          }
+        } else {
+          // add/sub: constant once both sources are; an untracked source is not
+          state = 1;
+          for (auto operand : version.operands) {
+            if (operand == -1 || ssa.versions[operand].state == 2) {
+              state = 2;
+              break;
+            }
+            if (ssa.versions[operand].state == 0) {
+              state = 0;
+            }
+          }
+          if (state == 1) {
+            // wraps around like the runtime's int64_t arithmetic
+            uint64_t lhs = ssa.versions[version.operands[0]].value;
+            uint64_t rhs = ssa.versions[version.operands[1]].value;
+            bool isAdd = getCatType(cast<CallInst>(version.inst)->getCalledFunction()) == 0;
+            value = (int64_t)(isAdd ? lhs + rhs : lhs - rhs);
+          }
+        }
+        if (state == version.state) {
+          continue;
+        }
+        version.state = state;
+        version.value = value;
+        for (auto user : version.users) {
+          workList.push_back(user);
+        }
+      }
+      for (auto& version : ssa.versions) {
+        if (version.state != 1) {
+          const char* reason = "non-constant-create";
+          if (version.inst == NULL) {
+            reason = version.state == 2 ? "non-uniform-phi" : "undefined";
+          } else if (getCatType(cast<CallInst>(version.inst)->getCalledFunction()) != 2) {
+            reason = "add-sub-write";
+          }
+          for (auto* read : version.reads) {
+            noteMissed(read, reason);
+          }
+          continue;
+        }
+        if (version.inst == NULL) {
+          NumFoldedPhis++;
+        }
+        for (auto* read : version.reads) {
+          auto* value = ConstantInt::get(read->getType(), version.value, true);
+          recordPropagation(read, value, "cat-ssa");
+          BasicBlock::iterator ii(read);
+          ReplaceInstWithValue(read->getParent()->getInstList(), ii, value);
+          modified = true;
+        }
+      }
+      // a version is needed when a read left in place or an add/sub that
+      // stays may see it, directly or through phis
+      std::vector<bool> needed(ssa.versions.size(), false);
+      std::vector<int> neededList;
+      auto need = [&](int v) {
+        if (v != -1 && !needed[v]) {
+          needed[v] = true;
+          neededList.push_back(v);
+        }
+      };
+      for (int v = 0; v < ssa.versions.size(); v++) {
+        auto& version = ssa.versions[v];
+        if (version.external || (version.state != 1 && !version.reads.empty())) {
+          need(v);
+        }
+        if (version.inst != NULL && !isCatCreate(version) && version.state != 1) {
+          for (auto operand : version.operands) {
+            need(operand);
+          }
+        }
+      }
+      while (!neededList.empty()) {
+        int v = neededList.back();
+        neededList.pop_back();
+        if (!isCatCreate(ssa.versions[v])) {
+          for (auto operand : ssa.versions[v].operands) {
+            need(operand);
+          }
+        }
+      }
+      for (int v = 0; v < ssa.versions.size(); v++) {
+        auto& version = ssa.versions[v];
+        if (version.inst == NULL || isCatCreate(version) || version.state != 1 || needed[v]) {
+          continue;
+        }
+        NumFoldedOps++;
+        recordFoldedOperation(cast<CallInst>(version.inst), version.value);
+        version.inst->eraseFromParent();
+        modified = true;
+      }
+      return modified;
+    }
+
+    bool runOnFunction (Function &F) override {
+      //errs() << "Hello LLVM World at \"runOnFunction\"\n" ;
+      if (trace) {
+        trace->record('B', "runOnFunction", &F);
+      }
+      bool modified = optimizeFunction(F);
+      if (funcWorkList.find(&F) != funcWorkList.end()) {
+        PhaseRegion deadOps(getPhaseTimers(PhaseDeadOps, &F));
+        modified = eliminateDeadCatOps(F) || modified;
+        deadOps.stop();
+        PhaseRegion scalarReplace(getPhaseTimers(PhaseScalarReplace, &F));
+        modified = scalarReplaceCats(F) || modified;
+        scalarReplace.stop();
+        PhaseRegion loopHoist(getPhaseTimers(PhaseLoopHoist, &F));
+        modified = hoistInvariantReads(F) || modified;
+        loopHoist.stop();
+        PhaseRegion readCSE(getPhaseTimers(PhaseReadCSE, &F));
+        modified = eliminateRedundantReads(F) || modified;
+        readCSE.stop();
+        reportMissed(F);
+      }
+      if (memReportOut && !memAccount.empty()) {
+        writeMemReport(F.getName());
+      }
+      if (trace) {
+        trace->record('E', "runOnFunction", &F);
+      }
+      return modified;
+    }
+
+    // after propagation, erase the create and add/subs of every tracked cell
+    // no CAT_get_signed_value reads any more, directly or through an add/sub
+    // into a live cell; tracked cells never escape, so nothing else can
+    bool eliminateDeadCatOps(Function &F) {
+      std::vector<Instruction*> cells;
+      std::map<Value*, bool> live;
+      for (auto& B : F) {
+        for (auto& I : B) {
+          if (auto* call = dyn_cast<CallInst>(&I)) {
+            if (getCatType(call->getCalledFunction()) == 2 && isTrackedCell(call)) {
+              cells.push_back(call);
+              live[call] = false;
+            }
+          }
+        }
+      }
+      std::vector<Value*> workList;
+      auto markLive = [&](Value* cell) {
+        auto it = live.find(cell);
+        if (it != live.end() && !it->second) {
+          it->second = true;
+          workList.push_back(cell);
+        }
+      };
+      for (auto* cell : cells) {
+        for (auto& U : cell->uses()) {
+          auto* call = cast<CallInst>(U.getUser());
+          int catType = getCatType(call->getCalledFunction());
+          // read, or a source of an add/sub into a cell that is not tracked
+          if (catType == 3 || (U.getOperandNo() > 0 && live.find(call->getArgOperand(0)) == live.end())) {
+            markLive(cell);
+          }
+        }
+      }
+      // the sources of every add/sub into a live cell are live too
+      while (!workList.empty()) {
+        auto* cell = workList.back();
+        workList.pop_back();
+        for (auto& U : cell->uses()) {
+          auto* call = cast<CallInst>(U.getUser());
+          if (U.getOperandNo() == 0 && getCatType(call->getCalledFunction()) <= 1) {
+            markLive(call->getArgOperand(1));
+            markLive(call->getArgOperand(2));
+          }
+        }
+      }
+      // every user of a dead cell is an add/sub into a dead cell
+      std::set<Instruction*> deadOps;
+      for (auto* cell : cells) {
+        if (live[cell]) {
+          continue;
+        }
+        for (auto* user : cell->users()) {
+          deadOps.insert(cast<Instruction>(user));
+        }
+      }
+      for (auto* op : deadOps) {
+        op->eraseFromParent();
+      }
+      NumDeadOps += deadOps.size();
+      bool modified = !deadOps.empty();
+      for (auto* cell : cells) {
+        if (!live[cell]) {
+          cell->eraseFromParent();
+          NumDeadOps++;
+          modified = true;
+        }
+      }
+      return modified;
+    }
+
+    // replace every tracked cell left by plain i64 SSA values: a create
+    // becomes its argument, an add/sub an add/sub instruction, a CAT-SSA phi
+    // an i64 phi, and every read the value of the version it reads
+    bool scalarReplaceCats(Function &F) {
+      DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+      CatSSA ssa;
+      buildCatSSA(F, DT, ssa);
+      if (ssa.cells.empty()) {
+        return false;
+      }
+      // an untracked or kept source is still read through the CAT API
+      Function* getValue = F.getParent()->getFunction(catApiNames[3]);
+      if (getValue == NULL) {
+        return false;
+      }
+      // a cell is kept when an add/sub into an untracked cell reads it, or
+      // an unreachable block uses it, since neither has a version to use
+      std::vector<bool> replace(ssa.cells.size(), true);
+      for (int c = 0; c < ssa.cells.size(); c++) {
+        for (auto* user : ssa.cells[c]->users()) {
+          if (!DT.isReachableFromEntry(cast<Instruction>(user)->getParent())) {
+            replace[c] = false;
+          }
+        }
+      }
+      for (auto& version : ssa.versions) {
+        if (version.external) {
+          replace[version.cell] = false;
+        }
+      }
+      // and so is every source of an add/sub into a kept cell, and a cell
+      // with an add/sub whose two sources would both need a read, as that
+      // would run two CAT calls where there was one
+      for (bool changed = true; changed; ) {
+        changed = false;
+        for (auto& version : ssa.versions) {
+          if (version.inst == NULL || isCatCreate(version)) {
+            continue;
+          }
+          int reads = 0;
+          for (auto operand : version.operands) {
+            if (operand == -1 || !replace[ssa.versions[operand].cell]) {
+              reads++;
+            } else if (!replace[version.cell]) {
+              replace[ssa.versions[operand].cell] = false;
+              changed = true;
+            }
+          }
+          if (replace[version.cell] && reads == 2) {
+            replace[version.cell] = false;
+            changed = true;
+          }
+        }
+      }
+      Type* int64Ty = Type::getInt64Ty(F.getContext());
+      std::vector<Value*> values(ssa.versions.size(), NULL);
+      std::set<PHINode*> phis;
+      for (int v = 0; v < ssa.versions.size(); v++) {
+        auto& version = ssa.versions[v];
+        if (replace[version.cell] && version.inst == NULL) {
+          auto* phi = PHINode::Create(int64Ty, version.operands.size(), "", &version.block->front());
+          phis.insert(phi);
+          values[v] = phi;
+        }
+      }
+      // versions are numbered in dominator tree order, so the sources of an
+      // add/sub always have their value already
+      for (int v = 0; v < ssa.versions.size(); v++) {
+        auto& version = ssa.versions[v];
+        if (!replace[version.cell] || version.inst == NULL) {
+          continue;
+        }
+        auto* call = cast<CallInst>(version.inst);
+        if (isCatCreate(version)) {
+          values[v] = call->getArgOperand(0);
+          continue;
+        }
+        IRBuilder<> builder(call);
+        Value* sources[2];
+        for (int j = 0; j < 2; j++) {
+          int operand = version.operands[j];
+          if (operand != -1 && replace[ssa.versions[operand].cell]) {
+            sources[j] = values[operand];
+          } else {
+            sources[j] = builder.CreateCall(getValue, call->getArgOperand(j + 1));
+          }
+        }
+        bool isAdd = getCatType(call->getCalledFunction()) == 0;
+        values[v] = isAdd ? builder.CreateAdd(sources[0], sources[1]) : builder.CreateSub(sources[0], sources[1]);
+      }
+      for (int v = 0; v < ssa.versions.size(); v++) {
+        auto& version = ssa.versions[v];
+        if (values[v] == NULL) {
+          continue;
+        }
+        if (version.inst == NULL) {
+          // every predecessor needs an entry, unreachable ones included
+          auto* phi = cast<PHINode>(values[v]);
+          std::map<BasicBlock*, Value*> incoming;
+          for (int k = 0; k < version.operands.size(); k++) {
+            int operand = version.operands[k];
+            incoming[version.preds[k]] = operand != -1 ? values[operand] : UndefValue::get(int64Ty);
+          }
+          for (auto PI = pred_begin(version.block), E = pred_end(version.block); PI != E; ++PI) {
+            auto it = incoming.find(*PI);
+            phi->addIncoming(it != incoming.end() ? it->second : UndefValue::get(int64Ty), *PI);
+          }
+        }
+        for (auto* read : version.reads) {
+          read->replaceAllUsesWith(values[v]);
+          missedReasons.erase(read);
+          read->eraseFromParent();
+        }
+      }
+      bool modified = false;
+      for (int v = 0; v < ssa.versions.size(); v++) {
+        if (values[v] != NULL && ssa.versions[v].inst != NULL && !isCatCreate(ssa.versions[v])) {
+          ssa.versions[v].inst->eraseFromParent();
+        }
+      }
+      for (int c = 0; c < ssa.cells.size(); c++) {
+        if (replace[c]) {
+          ssa.cells[c]->eraseFromParent();
+          NumScalarReplacedCells++;
+          modified = true;
+        }
+      }
+      // phis no instruction outside the new phis reads are dropped
+      std::set<PHINode*> livePhis;
+      std::vector<PHINode*> workList;
+      for (auto* phi : phis) {
+        for (auto* user : phi->users()) {
+          if (!isa<PHINode>(user) || phis.find(cast<PHINode>(user)) == phis.end()) {
+            if (livePhis.insert(phi).second) {
+              workList.push_back(phi);
+            }
+            break;
+          }
+        }
+      }
+      while (!workList.empty()) {
+        auto* phi = workList.back();
+        workList.pop_back();
+        for (auto& incoming : phi->incoming_values()) {
+          if (auto* operand = dyn_cast<PHINode>(incoming)) {
+            if (phis.find(operand) != phis.end() && livePhis.insert(operand).second) {
+              workList.push_back(operand);
+            }
+          }
+        }
+      }
+      for (auto* phi : phis) {
+        if (livePhis.find(phi) == livePhis.end()) {
+          phi->replaceAllUsesWith(UndefValue::get(int64Ty));
+        }
+      }
+      for (auto* phi : phis) {
+        if (livePhis.find(phi) == livePhis.end()) {
+          phi->eraseFromParent();
+        }
+      }
+      return modified;
+    }
+
+    bool isCatCreate(Value* value) {
+      auto* call = dyn_cast<CallInst>(value);
+      return call != NULL && getCatType(call->getCalledFunction()) == 2;
+    }
+
+    // isTrackedCell of a CAT value, memoized in tracked
+    bool isTrackedValue(Value* value, std::map<Value*, bool> &tracked) {
+      if (!isCatCreate(value)) {
+        return false;
+      }
+      auto it = tracked.find(value);
+      if (it == tracked.end()) {
+        it = tracked.insert(std::make_pair(value, isTrackedCell(cast<Instruction>(value)))).first;
+      }
+      return it->second;
+    }
+
+    // whether a write to the CAT value dest may change the cell read through
+    // value; creates are distinct cells, and a tracked create only ever
+    // reaches CAT calls directly, so it aliases nothing but itself
+    bool mayAliasCat(Value* dest, Value* value, std::map<Value*, bool> &tracked) {
+      if (dest == value) {
+        return true;
+      }
+      if (isCatCreate(dest) && isCatCreate(value)) {
+        return false;
+      }
+      return !isTrackedValue(dest, tracked) && !isTrackedValue(value, tracked);
+    }
+
+    void loopsInnermostFirst(Loop* L, std::vector<Loop*> &loops) {
+      for (auto* subLoop : *L) {
+        loopsInnermostFirst(subLoop, loops);
+      }
+      loops.push_back(L);
+    }
+
+    // move every CAT_get_signed_value of a loop to its preheader when no
+    // definition inside the loop can reach it: no add/sub in the loop may
+    // write the cell and, if the cell escapes, no call in the loop may
+    // write it either; the reads of one cell share a single hoisted call
+    // a read is only moved when it runs whenever the loop is entered, i.e.
+    // its block dominates every exit, so hoisting never adds a call the loop
+    // did not make; other invariant reads of a cell, creates included, only
+    // reuse a read hoisted anyway
+    bool hoistInvariantReads(Function &F) {
+      LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+      DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+      std::vector<Loop*> loops;
+      for (auto* L : LI) {
+        loopsInnermostFirst(L, loops);
+      }
+      std::map<Value*, bool> tracked;
+      bool modified = false;
+      for (auto* L : loops) {
+        auto* preheader = L->getLoopPreheader();
+        if (preheader == NULL) {
+          continue;
+        }
+        std::vector<Value*> dests;
+        std::vector<CallInst*> reads;
+        bool unknownCall = false;
+        for (auto* B : L->blocks()) {
+          for (auto& I : *B) {
+            auto* call = dyn_cast<CallInst>(&I);
+            if (call == NULL) {
+              continue;
+            }
+            int catType = getCatType(call->getCalledFunction());
+            if (catType <= 1 && catType != -1) {
+              dests.push_back(call->getArgOperand(0));
+            } else if (catType == 3) {
+              reads.push_back(call);
+            } else if (catType == -1 && !call->onlyReadsMemory()) {
+              unknownCall = true;
+            }
+          }
+        }
+        SmallVector<BasicBlock*, 8> exits;
+        L->getExitBlocks(exits);
+        std::vector<CallInst*> invariantReads, speculative;
+        for (auto* read : reads) {
+          Value* cell = read->getArgOperand(0);
+          if (auto* def = dyn_cast<Instruction>(cell)) {
+            if (L->contains(def) || !DT.dominates(def, preheader->getTerminator())) {
+              continue;
+            }
+          }
+          bool invariant = true;
+          for (auto* dest : dests) {
+            if (mayAliasCat(dest, cell, tracked)) {
+              invariant = false;
+              break;
+            }
+          }
+          if (!invariant || (unknownCall && !isTrackedValue(cell, tracked))) {
+            continue;
+          }
+          bool executes = !exits.empty();
+          for (auto* exit : exits) {
+            if (!DT.dominates(read->getParent(), exit)) {
+              executes = false;
+              break;
+            }
+          }
+          if (executes) {
+            invariantReads.push_back(read);
+          } else {
+            speculative.push_back(read);
+          }
+        }
+        std::map<Value*, CallInst*> hoisted;
+        for (auto* read : invariantReads) {
+          Value* cell = read->getArgOperand(0);
+          auto it = hoisted.find(cell);
+          if (it == hoisted.end()) {
+            read->moveBefore(preheader->getTerminator());
+            hoisted[cell] = read;
+          } else {
+            read->replaceAllUsesWith(it->second);
+            missedReasons.erase(read);
+            read->eraseFromParent();
+          }
+          NumHoistedReads++;
+          modified = true;
+        }
+        for (auto* read : speculative) {
+          auto it = hoisted.find(read->getArgOperand(0));
+          if (it == hoisted.end()) {
+            continue;
+          }
+          read->replaceAllUsesWith(it->second);
+          missedReasons.erase(read);
+          read->eraseFromParent();
+          NumHoistedReads++;
+          modified = true;
+        }
+      }
+      return modified;
+    }
+
+    // the CAT writes of a block: add/sub destinations, and whether a call
+    // that may write memory can change the escaped cells
+    struct CatBlockWrites {
+      std::vector<Value*> dests;
+      bool unknownCall;
+    };
+
+    // drop the available reads a write to dest, or an unknown call, may change
+    void killReads(std::map<Value*, CallInst*> &available, Value* dest, bool unknownCall, std::map<Value*, bool> &tracked) {
+      for (auto it = available.begin(); it != available.end(); ) {
+        if ((dest != NULL && mayAliasCat(dest, it->first, tracked)) || (unknownCall && !isTrackedValue(it->first, tracked))) {
+          it = available.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    // value numbering of CAT_get_signed_value over the dominator tree: a
+    // read is replaced by an earlier read of the same cell that dominates it
+    // when the same definitions reach both, i.e. no add/sub that may write
+    // the cell, and for an escaped cell no unknown call, lies on any path
+    // between them
+    // a block inherits the reads available at the end of its immediate
+    // dominator, minus those killed in the blocks on the way from it
+    bool eliminateRedundantReads(Function &F) {
+      DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+      std::map<BasicBlock*, CatBlockWrites> writes;
+      for (auto& B : F) {
+        auto& blockWrites = writes[&B];
+        blockWrites.unknownCall = false;
+        for (auto& I : B) {
+          if (auto* call = dyn_cast<CallInst>(&I)) {
+            int catType = getCatType(call->getCalledFunction());
+            if (catType == 0 || catType == 1) {
+              blockWrites.dests.push_back(call->getArgOperand(0));
+            } else if (catType == -1 && !call->onlyReadsMemory()) {
+              blockWrites.unknownCall = true;
+            }
+          }
+        }
+      }
+      std::map<Value*, bool> tracked;
+      std::map<BasicBlock*, std::map<Value*, CallInst*>> availableOut;
+      bool modified = false;
+      std::vector<std::pair<DomTreeNode*, bool>> walk;
+      walk.push_back(std::make_pair(DT.getRootNode(), false));
+      while (!walk.empty()) {
+        auto* node = walk.back().first;
+        bool leaving = walk.back().second;
+        walk.pop_back();
+        auto* B = node->getBlock();
+        if (leaving) {
+          availableOut.erase(B);
+          continue;
+        }
+        std::map<Value*, CallInst*> available;
+        if (node->getIDom() != NULL) {
+          auto* idom = node->getIDom()->getBlock();
+          available = availableOut[idom];
+          if (B->getSinglePredecessor() != idom) {
+            // every block on a path from the end of idom to B
+            std::set<BasicBlock*> between;
+            std::vector<BasicBlock*> workList(pred_begin(B), pred_end(B));
+            while (!workList.empty() && !available.empty()) {
+              auto* P = workList.back();
+              workList.pop_back();
+              if (P == idom || !between.insert(P).second) {
+                continue;
+              }
+              for (auto* dest : writes[P].dests) {
+                killReads(available, dest, false, tracked);
+              }
+              if (writes[P].unknownCall) {
+                killReads(available, NULL, true, tracked);
+              }
+              workList.insert(workList.end(), pred_begin(P), pred_end(P));
+            }
+          }
+        }
+        for (auto II = B->begin(); II != B->end(); ) {
+          auto* call = dyn_cast<CallInst>(&*II++);
+          if (call == NULL) {
+            continue;
+          }
+          int catType = getCatType(call->getCalledFunction());
+          if (catType == 3) {
+            auto it = available.find(call->getArgOperand(0));
+            if (it == available.end()) {
+              available[call->getArgOperand(0)] = call;
+              continue;
+            }
+            call->replaceAllUsesWith(it->second);
+            missedReasons.erase(call);
+            call->eraseFromParent();
+            NumRedundantReads++;
+            modified = true;
+          } else if (catType == 0 || catType == 1) {
+            killReads(available, call->getArgOperand(0), false, tracked);
+          } else if (catType == -1 && !call->onlyReadsMemory()) {
+            killReads(available, NULL, true, tracked);
+          }
+        }
+        availableOut[B] = available;
+        walk.push_back(std::make_pair(node, true));
+        for (auto* child : *node) {
+          walk.push_back(std::make_pair(child, false));
+        }
+      }
+      return modified;
+    }
+
+    bool optimizeFunction (Function &F) {
+      if (F.isDeclaration() || funcWorkList.find(&F) == funcWorkList.end()) {
+        return false;
+      }
+      // errs()<< F.getName() << " in work list!\n";
+      // reads of tracked cells are settled on CAT-SSA; the dense solver only
+      // runs when some read is left on a cell that CAT-SSA does not track
+      CatSSA ssa;
+      PhaseRegion catSSA(getPhaseTimers(PhaseCatSSA, &F));
+      buildCatSSA(F, getAnalysis<DominatorTreeWrapperPass>().getDomTree(), ssa);
+      bool modified = propagateCatSSA(ssa);
+      catSSA.stop();
+      if (memReportOut) {
+        uint64_t bytes = containerBytes(ssa.cells) + containerBytes(ssa.cellMap) + containerBytes(ssa.versions);
+        for (auto& version : ssa.versions) {
+          bytes += containerBytes(version.operands) + containerBytes(version.preds) + containerBytes(version.users) + containerBytes(version.reads);
+        }
+        memAccount.push_back(std::make_pair("CAT-SSA", bytes));
+      }
+      uint64_t numBlocks = 0, numDefs = 0, numUntrackedReads = 0;
+      for (auto& B : F) {
+        numBlocks++;
+        for (auto& I : B) {
+          if (auto* call = dyn_cast<CallInst>(&I)) {
+            int catType = getCatType(call->getCalledFunction());
+            if (catType != -1 && catType != 3) {
+              numDefs++;
+            }
+            if (catType == 3 && ssa.cellMap.find(call->getArgOperand(0)) == ssa.cellMap.end()) {
+              numUntrackedReads++;
+            }
+          }
+        }
+      }
+      if (numUntrackedReads == 0) {
+        return modified;
+      }
+      if (numBlocks * numDefs > DenseBitLimit) {
+        return solveAndPropagate<SparseBitVector<>>(F) || modified;
+      }
+      return solveAndPropagate<BitVector>(F) || modified;
+    }
+
+    // reaching definitions over definition-indexed bit vectors, followed by
+    // constant propagation into CAT_get_signed_value
+    // the fixed point runs on whole blocks; IN sets of single instructions are
+    // only rebuilt for the CAT_get_signed_value calls that propagation reads
+    template <typename DefSet>
+    bool solveAndPropagate(Function &F) {
+      bool modified = false;
+      PhaseRegion numbering(getPhaseTimers(PhaseGenKill, &F));
+      std::vector<Instruction *> insV;
+      // every CAT create/add/sub gets a dense definition number
+      std::vector<Instruction *> defV;
+      std::map<Instruction*, int> defMap;
+      // every CAT variable gets a dense number too, defVar maps a definition to it
+      std::map<Value*, int> varMap;
+      std::vector<int> defVar;
+      for (auto& B : F) {
+        for (auto& I : B) {
+          insV.push_back(&I);
+          if (auto* call = dyn_cast<CallInst>(&I)) {
+            int catType = getCatType(call->getCalledFunction());
+            if (catType != -1 && catType != 3) {
+              // the variable a definition writes: the create itself, or the
+              // first operand of an add/sub
+              Value* var = catType == 2 ? call : call->getArgOperand(0);
+              auto it = varMap.find(var);
+              if (it == varMap.end()) {
+                it = varMap.insert(std::make_pair(var, (int)varMap.size())).first;
+              }
+              defMap[&I] = defV.size();
+              defV.push_back(&I);
+              defVar.push_back(it->second);
+            }
+          }
+        }
+      }
+      numbering.stop();
+      PhaseRegion escape(getPhaseTimers(PhaseEscape, &F));
+      std::set<Instruction*> escapeSet, escapeSetSpecific;
+      for (int i = 0; i < insV.size(); i++) {
+        // for every cat value get pointed, recognized as escaping
+        if (auto* ptrInst = dyn_cast<StoreInst>(insV[i])) {
+          if (auto* escapeInst = dyn_cast<Instruction>(ptrInst->getValueOperand())) {
+            escapeSet.insert(escapeInst);
+          }
+        }
+        if (auto* tempInst= dyn_cast<CallInst>(insV[i])) {
+          if (tempInst->getNumArgOperands() > 0) {
+            if (getCatType(tempInst->getCalledFunction()) == -1) {
+              if (auto* escapeInst = dyn_cast<CallInst>(tempInst->getArgOperand(0))) {
+                if (getCatType(escapeInst->getCalledFunction()) == 2) {
+                  escapeSet.insert(escapeInst);
+                }
+              }
+              for (int j = 0; j < tempInst->getNumArgOperands(); j++) {
+                if (auto* escapeInst = dyn_cast<CallInst>(tempInst->getArgOperand(j))) {
+                  if (getCatType(escapeInst->getCalledFunction()) == 2) {
+                    escapeSetSpecific.insert(escapeInst);
+                    // errs()<< *escapeInst <<  "\n";
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+      escape.stop();
+      // reads that need reaching definitions; the demand-driven queries only
+      // answer "which definitions of the read's own variable reach it", which
+      // is all propagation looks at unless that variable escapes
+      int numQueries = 0;
+      bool escapedQuery = false;
+      for (auto* I : insV) {
+        if (auto* call = dyn_cast<CallInst>(I)) {
+          if (getCatType(call->getCalledFunction()) == 3) {
+            auto* operandInst = dyn_cast<Instruction>(call->getArgOperand(0));
+            if (operandInst != NULL && !isa<LoadInst>(operandInst) && !isa<PHINode>(operandInst)) {
+              numQueries++;
+              if (escapeSet.find(operandInst) != escapeSet.end()) {
+                escapedQuery = true;
+              }
+            }
+          }
+        }
+      }
+      bool demandDriven = !escapedQuery && numQueries * DefsPerDemandQuery <= defV.size();
+      std::map<Instruction*, std::vector<Instruction*>> demandInSets;
+      dataflow::SetInterner<DefSet> inSetPool;
+      std::map<Instruction*, const DefSet*> useInMap;
+      std::map<const DefSet*, std::vector<Instruction*>> expandedInSets;
+      if (demandDriven) {
+        PhaseRegion fixedPoint(getPhaseTimers(PhaseFixedPoint, &F));
+        queryReachingDefs(F, defV, defMap, defVar, varMap, demandInSets);
+        fixedPoint.stop();
+        if (dumpOut) {
+          dumpReadSets(F, demandInSets);
+        }
+      } else {
+        PhaseRegion genKill(getPhaseTimers(PhaseGenKill, &F));
+        typedef dataflow::LatticeTraits<DefSet> Traits;
+        // per-variable definition masks: KILL(d) is varDefs[var(d)] without d,
+        // so applying d is "remove varDefs[var(d)], then add d" and no kill
+        // set is ever built per definition
+        std::vector<DefSet> varDefs(varMap.size());
+        for (auto& varDef : varDefs) {
+          Traits::init(varDef, defV.size(), false);
+        }
+        for (int d = 0; d < defV.size(); d++) {
+          varDefs[defVar[d]].set(d);
+        }
+        // collapse every block into one gen/kill pair:
+        //   gen = gen_i U (gen - kill_i), kill = (kill U kill_i) - gen_i
+        dataflow::GenKillTransfer<DefSet> transfer;
+        dataflow::ReachingDefsSolver<DefSet> solver(F, defV.size(), transfer);
+        transfer.gen.resize(solver.getNumBlocks());
+        transfer.kill.resize(solver.getNumBlocks());
+        for (int b = 0; b < solver.getNumBlocks(); b++) {
+          Traits::init(transfer.gen[b], defV.size(), false);
+          Traits::init(transfer.kill[b], defV.size(), false);
+          for (auto& I : *solver.getBlock(b)) {
+            auto it = defMap.find(&I);
+            if (it == defMap.end()) {
+              continue;
+            }
+            Traits::subtract(transfer.gen[b], varDefs[defVar[it->second]]);
+            transfer.gen[b].set(it->second);
+            Traits::join(transfer.kill[b], varDefs[defVar[it->second]]);
+            transfer.kill[b].reset(it->second);
+          }
+        }
+        genKill.stop();
+        PhaseRegion fixedPoint(getPhaseTimers(PhaseFixedPoint, &F));
+        if (trace) {
+          int sweep = 0;
+          solver.setSweepObserver([&](bool begin) {
+            trace->record(begin ? 'B' : 'E', "fixed-point sweep", &F, begin ? ++sweep : sweep);
+          });
+        }
+        solver.solve();
+        NumFixedPointIterations += solver.getNumVisits();
+        if (solverStatsOut) {
+          writeSolverStats(F, solver, defV.size(), std::is_same<DefSet, BitVector>::value ? "dense" : "sparse");
+        }
+        // replay each block from its inset, recording the inset of every
+        // CAT_get_signed_value on the way; insets are interned, so reads with
+        // no definition in between share one set, and each distinct set is
+        // expanded into instructions only once
+        // a block's inset is only interned when one of its reads needs it
+        for (auto& B : F) {
+          const DefSet& blockInSet = solver.getIn(solver.getIndex(&B));
+          const DefSet* inSetPtr = NULL;
+          DefSet tempInSet;
+          bool changed = false;
+          for (auto& I : B) {
+            auto it = defMap.find(&I);
+            if (it != defMap.end()) {
+              if (!changed) {
+                tempInSet = inSetPtr != NULL ? *inSetPtr : blockInSet;
+                changed = true;
+              }
+              Traits::subtract(tempInSet, varDefs[defVar[it->second]]);
+              tempInSet.set(it->second);
+            } else if (auto* call = dyn_cast<CallInst>(&I)) {
+              if (getCatType(call->getCalledFunction()) == 3) {
+                if (changed) {
+                  inSetPtr = inSetPool.intern(tempInSet);
+                  changed = false;
+                } else if (inSetPtr == NULL) {
+                  inSetPtr = inSetPool.intern(blockInSet);
+                }
+                useInMap[&I] = inSetPtr;
+              }
+            }
+          }
+        }
+        fixedPoint.stop();
+        if (dumpOut) {
+          dumpSets(F, solver, transfer, defV, useInMap);
+        }
+        if (memReportOut) {
+          uint64_t genKillBytes = containerBytes(varDefs) + containerBytes(transfer.gen) + containerBytes(transfer.kill);
+          for (auto& varDef : varDefs) {
+            genKillBytes += Traits::bytes(varDef);
+          }
+          for (int b = 0; b < solver.getNumBlocks(); b++) {
+            genKillBytes += Traits::bytes(transfer.gen[b]) + Traits::bytes(transfer.kill[b]);
+          }
+          memAccount.push_back(std::make_pair("GEN/KILL", genKillBytes));
+          memAccount.push_back(std::make_pair("IN/OUT", (uint64_t)solver.getMemoryBytes()));
+        }
+      }
+      // constant propagation with data dependence
+      // H4 starts here
+      // modified to H7 version
+      DependenceAnalysis &deps = getAnalysis<DependenceAnalysis>();
+      PhaseRegion propagate(getPhaseTimers(PhasePropagate, &F));
+      for(int i = 0; i < insV.size(); i++) {
+        if (auto* call = dyn_cast<CallInst>(insV[i])) {
+          Function* callee = call->getCalledFunction();
+          // if from get_signed_value
           if (getCatType(callee) == 3) {
             Instruction* reachDef = NULL;
             auto* argValue = call->getArgOperand(0);
+            // why the read stays, if no definition folds it
+            const char* missed = isa<Argument>(argValue) ? "argument" : "no-reaching-definition";
 
               // check phi node
             if (auto* phiNode = dyn_cast<PHINode>(argValue)) {
               // auto* phiNode = cast<PHINode>(argValue);
               if (phiNodeHelper(phiNode).first) {
                 reachDef = cast<Instruction>(phiNode->getIncomingValue(0));
+              } else {
+                missed = "non-uniform-phi";
               }
             } else {
               if (Instruction* operandInst = dyn_cast<Instruction>(argValue)) {
                   // if not from mem
                 if (!isa<LoadInst>(operandInst)) {
                   auto operandCall = cast<CallInst>(operandInst);
+                  if (getCatType(operandCall->getCalledFunction()) != 2) {
+                    missed = "call-result";
+                  }
                   if (sumMap.find(operandCall->getCalledFunction()) != sumMap.end()) {
                     // funcSum summary = sumMap[operandCall->getCalledFunction()];
                     // auto* funcValue = getValue(summary, operandCall); 
@@ -501,25 +2244,40 @@ namespace {
                     // if (summary.cmpV.size()==0 && isa<ConstantInt>(funcValue)) {
                     if (isa<ConstantInt>(funcValue)) {
                       // errs() << summary.cmpV.size() << "\n";
+                      NumSummaryHits++;
+                      recordPropagation(call, funcValue, "summary");
                       BasicBlock::iterator ii(insV[i]);
                       ReplaceInstWithValue(insV[i]->getParent()->getInstList(),ii,funcValue);
                       modified = true;
                       continue;
                     }
                   }
-                  std::set<Instruction*> inSet = inMap[i];
+                  const std::vector<Instruction*>* inSetV;
+                  if (demandDriven) {
+                    inSetV = &demandInSets[insV[i]];
+                  } else {
+                    const DefSet* inSetPtr = useInMap[insV[i]];
+                    auto expanded = expandedInSets.find(inSetPtr);
+                    if (expanded == expandedInSets.end()) {
+                      expanded = expandedInSets.insert(std::make_pair(inSetPtr, expandDefSet(*inSetPtr, defV))).first;
+                    }
+                    inSetV = &expanded->second;
+                  }
+                  const std::vector<Instruction*> &inSet = *inSetV;
                   for (auto* inInst : inSet) {
                     if (auto* subInst = dyn_cast<CallInst>(inInst)) {
                       if (inInst == operandInst) {
                         if (escapeSetSpecific.find(operandInst) != escapeSetSpecific.end()) {
                           // errs()<<*operandInst << "\n";
                           reachDef = NULL;
+                          missed = "escaped";
                           break;
                         }
                         reachDef = subInst;
                       } else {
                         if (subInst->getNumOperands() > 0 && subInst->getArgOperand(0) == operandInst) {
                           reachDef = NULL;
+                          missed = "add-sub-write";
                           break;
                         }
 
@@ -527,8 +2285,15 @@ namespace {
                               //check depend on add or sub instruction in escape
 
                           if (getCatType(subInst->getCalledFunction()) <= 1) {
-                            if (deps.depends(call, subInst, false)) {
+                            bool depends;
+                            NumDependenceQueries++;
+                            {
+                              PhaseRegion dependence(getPhaseTimers(PhaseDependence, &F));
+                              depends = (bool)deps.depends(call, subInst, false);
+                            }
+                            if (depends) {
                               reachDef = NULL;
+                              missed = "dependence";
                               break;
                             } else {
                               reachDef = subInst;
@@ -539,6 +2304,8 @@ namespace {
                     }
                   }
 
+                } else {
+                  missed = "load";
                 }
               }
             }
@@ -550,15 +2317,37 @@ namespace {
                 // if (isa<ConstantInt>(value)) {
                 //   ConstantInt *c = cast<ConstantInt>(value);
                 if (auto* c = dyn_cast<ConstantInt>(reachCall->getArgOperand(0))) {
+                  if (isa<PHINode>(argValue)) {
+                    NumFoldedPhis++;
+                  }
+                  recordPropagation(call, c, isa<PHINode>(argValue) ? "phi" : "reaching-defs");
                   BasicBlock::iterator ii(insV[i]);
                   ReplaceInstWithValue(insV[i]->getParent()->getInstList(), ii, c);
                   modified = true;
+                  continue;
                 }
+                // a create with a runtime argument, or an escaped add/sub
+                missed = getCatType(reachCall->getCalledFunction()) == 2 ? "non-constant-create" : "escaped";
               }
             }
+            noteMissed(call, missed);
           }
         }
       }
+      if (memReportOut) {
+        // the read IN sets grow until the end of propagation
+        uint64_t readBytes = inSetPool.bytes() + containerBytes(useInMap) + containerBytes(expandedInSets) + containerBytes(demandInSets);
+        for (auto& expanded : expandedInSets) {
+          readBytes += containerBytes(expanded.second);
+        }
+        for (auto& demand : demandInSets) {
+          readBytes += containerBytes(demand.second);
+        }
+        memAccount.push_back(std::make_pair("instructions", containerBytes(insV)));
+        memAccount.push_back(std::make_pair("definitions", containerBytes(defV) + containerBytes(defMap) + containerBytes(defVar) + containerBytes(varMap)));
+        memAccount.push_back(std::make_pair("escape sets", containerBytes(escapeSet) + containerBytes(escapeSetSpecific)));
+        memAccount.push_back(std::make_pair("read IN sets", readBytes));
+      }
       //printSets(F, insV, inMap, outMap, "IN", "OUT");
       // insV.clear();
       // genMap.clear();
@@ -570,12 +2359,163 @@ namespace {
       return modified;
     }
 
-    // We don't modify the program, so we preserve all analyses.
+    // We rewrite and erase CAT calls, so no analysis is preserved; the CFG
+    // is left alone (only -CAT-profile splits blocks)
     // The LLVM IR of functions isn't ready at this point
     void getAnalysisUsage(AnalysisUsage &AU) const override {
       //errs() << "Hello LLVM World at \"getAnalysisUsage\"\n" ;
-      // AU.setPreservesAll();
       AU.addRequiredTransitive<DependenceAnalysis>();
+      AU.addRequired<DominatorTreeWrapperPass>();
+      AU.addRequired<LoopInfoWrapperPass>();
+    }
+  };
+
+  // -cat-profile: counts, per call site, every CAT call the CAT pass left.
+  // It instruments the whole module after the CAT pass ran over it, so it
+  // is a module pass of its own: it creates the counters, the runtime
+  // declarations and the constructor, and splits the entry blocks
+  struct CATProfile : public ModulePass {
+    static char ID;
+
+    // CAT API declaration -> index in catApiNames
+    DenseMap<Function*, int> catApi;
+
+    // the constructor registering the counters of every instrumented
+    // function with the CatProfile.c runtime
+    Function* profileInit = NULL;
+    Value* profilePath = NULL;
+
+    CATProfile() : ModulePass(ID) {}
+
+    bool runOnModule(Module &M) override {
+      catApi.clear();
+      for (int i = 0; i < sizeof(catApiNames) / sizeof(catApiNames[0]); i++) {
+        if (Function* api = M.getFunction(catApiNames[i])) {
+          catApi[api] = i;
+        }
+      }
+      if (catApi.empty()) {
+        return false;
+      }
+      LLVMContext &C = M.getContext();
+      profileInit = Function::Create(FunctionType::get(Type::getVoidTy(C), false), GlobalValue::InternalLinkage, "__cat_prof_init", &M);
+      IRBuilder<> builder(ReturnInst::Create(C, BasicBlock::Create(C, "entry", profileInit)));
+      profilePath = builder.CreateGlobalStringPtr(CatProfile, "__cat_prof_path");
+      appendToGlobalCtors(M, profileInit, 0);
+      // instrumentCatCalls adds functions to the module
+      std::vector<Function*> funcs;
+      for (auto &F : M) {
+        if (!F.isDeclaration()) {
+          funcs.push_back(&F);
+        }
+      }
+      for (auto* F : funcs) {
+        instrumentCatCalls(*F);
+      }
+      return true;
+    }
+
+    int getCatType(Function* callee) const {
+      auto it = catApi.find(callee);
+      if (it == catApi.end()) {
+        return -1;
+      }
+      return it->second;
+    }
+
+    // each function gets one thread-local 64-bit counter per CAT call site
+    // left after the function is transformed, bumped right before the call;
+    // the runtime merges a thread's counters when it exits, and writes the
+    // totals at exit
+    // site table entry: function name, NUL, API index byte, then the debug
+    // line of the call as 4 little-endian bytes (0 when unknown)
+    bool instrumentCatCalls(Function &F) {
+      std::vector<CallInst*> sites;
+      std::string table;
+      for (auto& B : F) {
+        for (auto& I : B) {
+          if (auto* call = dyn_cast<CallInst>(&I)) {
+            int catType = getCatType(call->getCalledFunction());
+            if (catType == -1) {
+              continue;
+            }
+            unsigned line = call->getDebugLoc() ? call->getDebugLoc().getLine() : 0;
+            sites.push_back(call);
+            table += F.getName();
+            table += '\0';
+            table += (char)catType;
+            for (int k = 0; k < 4; k++) {
+              table += (char)((line >> (8 * k)) & 0xff);
+            }
+          }
+        }
+      }
+      if (sites.empty()) {
+        return false;
+      }
+      Module &M = *F.getParent();
+      LLVMContext &C = M.getContext();
+      Type* int32Ty = Type::getInt32Ty(C);
+      Type* int64Ty = Type::getInt64Ty(C);
+      Type* int8PtrTy = Type::getInt8PtrTy(C);
+      ArrayType* countsTy = ArrayType::get(int64Ty, sites.size());
+      auto* counts = new GlobalVariable(M, countsTy, false, GlobalValue::InternalLinkage,
+        ConstantAggregateZero::get(countsTy), "__cat_prof_counts." + F.getName(), NULL, GlobalVariable::GeneralDynamicTLSModel);
+      for (int i = 0; i < sites.size(); i++) {
+        IRBuilder<> builder(sites[i]);
+        Value* counter = builder.CreateConstInBoundsGEP2_32(countsTy, counts, 0, i);
+        builder.CreateStore(builder.CreateAdd(builder.CreateLoad(counter), ConstantInt::get(int64Ty, 1)), counter);
+      }
+
+      // the counters of the calling thread; only code running in that thread
+      // can take the address of its thread-local copy
+      auto* countersTy = FunctionType::get(PointerType::getUnqual(int64Ty), false);
+      auto* counters = Function::Create(countersTy, GlobalValue::InternalLinkage, "__cat_prof_counters." + F.getName(), &M);
+      IRBuilder<> builder(BasicBlock::Create(C, "entry", counters));
+      builder.CreateRet(builder.CreateConstInBoundsGEP2_32(countsTy, counts, 0, 0));
+
+      // void CAT_profile_register(uint64_t *(*counters)(void), uint32_t numSites,
+      //                           const char *table, uint32_t tableSize, const char *path)
+      Function* reg = M.getFunction("CAT_profile_register");
+      if (reg == NULL) {
+        Type* params[] = {PointerType::getUnqual(countersTy), int32Ty, int8PtrTy, int32Ty, int8PtrTy};
+        reg = Function::Create(FunctionType::get(Type::getVoidTy(C), params, false), GlobalValue::ExternalLinkage, "CAT_profile_register", &M);
+      }
+      builder.SetInsertPoint(profileInit->getEntryBlock().getTerminator());
+      auto* tableData = ConstantDataArray::getString(C, table, false);
+      auto* tableVar = new GlobalVariable(M, tableData->getType(), true, GlobalValue::PrivateLinkage, tableData, "__cat_prof_table." + F.getName());
+      Value* args[] = {
+        counters,
+        ConstantInt::get(int32Ty, sites.size()),
+        builder.CreateConstInBoundsGEP2_32(tableData->getType(), tableVar, 0, 0),
+        ConstantInt::get(int32Ty, table.size()),
+        profilePath,
+      };
+      builder.CreateCall(reg, args);
+
+      // the first time a thread runs an instrumented function of the module,
+      // CAT_profile_thread_enter arms the runtime's flush at thread exit
+      Type* int8Ty = Type::getInt8Ty(C);
+      GlobalVariable* entered = M.getGlobalVariable("__cat_prof_thread", true);
+      if (entered == NULL) {
+        entered = new GlobalVariable(M, int8Ty, false, GlobalValue::InternalLinkage,
+          ConstantInt::get(int8Ty, 0), "__cat_prof_thread", NULL, GlobalVariable::GeneralDynamicTLSModel);
+      }
+      Function* enter = M.getFunction("CAT_profile_thread_enter");
+      if (enter == NULL) {
+        enter = Function::Create(FunctionType::get(Type::getVoidTy(C), false), GlobalValue::ExternalLinkage, "CAT_profile_thread_enter", &M);
+      }
+      BasicBlock::iterator start = F.getEntryBlock().getFirstInsertionPt();
+      while (isa<AllocaInst>(start)) {
+        ++start;
+      }
+      IRBuilder<> entry(&*start);
+      Value* isNew = entry.CreateICmpEQ(entry.CreateLoad(entered), ConstantInt::get(int8Ty, 0));
+      auto* enterThread = SplitBlockAndInsertIfThen(isNew, &*start, false);
+      entry.SetInsertPoint(enterThread);
+      entry.CreateStore(ConstantInt::get(int8Ty, 1), entered);
+      entry.CreateCall(enter);
+      return true;
     }
   };
 }
@@ -583,12 +2523,20 @@ namespace {
 // Next there is code to register your pass to "opt"
 char CAT::ID = 0;
 static RegisterPass<CAT> X("CAT", "Homework for the CAT class");
+char CATProfile::ID = 0;
+static RegisterPass<CATProfile> Y("CAT-profile", "Count the CAT calls left per call site");
 
 // Next there is code to register your pass to "clang"
 static CAT * _PassMaker = NULL;
+static void addCATPasses(legacy::PassManagerBase& PM) {
+  PM.add(_PassMaker = new CAT());
+  if (CatProfile.getNumOccurrences()) {
+    PM.add(new CATProfile());
+  }
+}
 static RegisterStandardPasses _RegPass1(PassManagerBuilder::EP_OptimizerLast,
   [](const PassManagerBuilder&, legacy::PassManagerBase& PM) {
-        if(!_PassMaker){ PM.add(_PassMaker = new CAT());}}); // ** for -Ox
+        if(!_PassMaker){ addCATPasses(PM);}}); // ** for -Ox
 static RegisterStandardPasses _RegPass2(PassManagerBuilder::EP_EnabledOnOptLevel0,
   [](const PassManagerBuilder&, legacy::PassManagerBase& PM) {
-        if(!_PassMaker){ PM.add(_PassMaker = new CAT()); }}); // ** for -O0
+        if(!_PassMaker){ addCATPasses(PM); }}); // ** for -O0
@@ -0,0 +1,134 @@
+// Runtime of the CatPass -cat-profile mode.
+//
+// Every instrumented function registers its thread-local per-site counters
+// from a module constructor. A thread's counters are folded into the shared
+// totals with atomic adds by CAT_profile_flush_thread, which runs
+//   - when a thread that ran instrumented code exits (pthread_exit or
+//     returning from its start routine), through a thread-specific key
+//     destructor armed by CAT_profile_thread_enter, and
+//   - in the thread running the exit handlers,
+// and the totals are appended to the profile file at exit. Counts of other
+// threads still running at exit are lost unless they call
+// CAT_profile_flush_thread themselves. The counters are never locked or
+// shared. Link with -pthread.
+//
+// Profile record, all integers little-endian:
+//   "CATP"  uint32 numSites  uint32 tableSize  table[tableSize]  uint64 counts[numSites]
+// one record per instrumented function; the site table is the one the pass
+// emitted, see instrumentCatCalls. CAT_PROFILE overrides the file name.
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct catProfileFunction {
+  uint64_t *(*counters)(void);
+  uint32_t numSites;
+  const char *table;
+  uint32_t tableSize;
+  const char *path;
+  uint64_t *totals;
+  struct catProfileFunction *next;
+};
+
+// constructors run in one thread, so the list needs no lock
+static struct catProfileFunction *catProfileFunctions = NULL;
+
+// set in every thread that ran instrumented code, to flush it at thread exit
+static pthread_key_t catProfileThreadKey;
+
+void CAT_profile_flush_thread (void) {
+  struct catProfileFunction *f;
+  for (f = catProfileFunctions; f != NULL; f = f->next) {
+    uint64_t *counts = f->counters();
+    uint32_t i;
+    for (i = 0; i < f->numSites; i++) {
+      if (counts[i] != 0) {
+        __atomic_fetch_add(&f->totals[i], counts[i], __ATOMIC_RELAXED);
+        counts[i] = 0;
+      }
+    }
+  }
+}
+
+static void catProfileThreadExit (void *unused) {
+  (void)unused;
+  CAT_profile_flush_thread();
+}
+
+// called by instrumented code the first time a thread runs it
+void CAT_profile_thread_enter (void) {
+  if (catProfileFunctions != NULL) {
+    pthread_setspecific(catProfileThreadKey, (void *)1);
+  }
+}
+
+static void writeLE (FILE *out, uint64_t value, int bytes) {
+  unsigned char buf[8];
+  int k;
+  for (k = 0; k < bytes; k++) {
+    buf[k] = (unsigned char)(value >> (8 * k));
+  }
+  fwrite(buf, 1, bytes, out);
+}
+
+static void catProfileExit (void) {
+  const char *override = getenv("CAT_PROFILE");
+  struct catProfileFunction *f;
+  FILE *out = NULL;
+  const char *outPath = NULL;
+  CAT_profile_flush_thread();
+  for (f = catProfileFunctions; f != NULL; f = f->next) {
+    const char *path = override != NULL ? override : f->path;
+    uint32_t i;
+    if (out == NULL || strcmp(path, outPath) != 0) {
+      if (out != NULL) {
+        fclose(out);
+      }
+      outPath = path;
+      out = fopen(path, "ab");
+      if (out == NULL) {
+        perror(path);
+        return;
+      }
+    }
+    fwrite("CATP", 1, 4, out);
+    writeLE(out, f->numSites, 4);
+    writeLE(out, f->tableSize, 4);
+    fwrite(f->table, 1, f->tableSize, out);
+    for (i = 0; i < f->numSites; i++) {
+      writeLE(out, f->totals[i], 8);
+    }
+  }
+  if (out != NULL) {
+    fclose(out);
+  }
+}
+
+void CAT_profile_register (uint64_t *(*counters)(void), uint32_t numSites,
+                           const char *table, uint32_t tableSize, const char *path) {
+  struct catProfileFunction *f = malloc(sizeof(*f));
+  uint64_t *totals = calloc(numSites, sizeof(uint64_t));
+  if (f == NULL || totals == NULL) {
+    free(f);
+    free(totals);
+    return;
+  }
+  if (catProfileFunctions == NULL) {
+    if (pthread_key_create(&catProfileThreadKey, catProfileThreadExit) != 0) {
+      free(f);
+      free(totals);
+      return;
+    }
+    atexit(catProfileExit);
+  }
+  f->counters = counters;
+  f->numSites = numSites;
+  f->table = table;
+  f->tableSize = tableSize;
+  f->path = path;
+  f->totals = totals;
+  f->next = catProfileFunctions;
+  catProfileFunctions = f;
+}
@@ -0,0 +1,351 @@
+#ifndef CAT_DATAFLOW_SOLVER_H
+#define CAT_DATAFLOW_SOLVER_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/Hashing.h"
+#include <vector>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+// Generic block-level dataflow solver.
+//
+//   DataflowSolver<Lattice, Direction, Meet, Transfer>
+//
+// Lattice   - the set type of a dataflow fact (BitVector or SparseBitVector<>)
+// Direction - Forward or Backward
+// Meet      - Union (may problems) or Intersection (must problems)
+// Transfer  - functor computing out = f_b(in) for block number b
+//
+// Everything is resolved at compile time, so one tuned worklist engine backs
+// reaching definitions, liveness, available expressions, ...
+namespace dataflow {
+  using namespace llvm;
+
+  // set operations the solver needs from a lattice element
+  template <typename SetT> struct LatticeTraits;
+
+  template <> struct LatticeTraits<BitVector> {
+    static void init(BitVector &s, unsigned width, bool full) {
+      s.clear();
+      s.resize(width, full);
+    }
+    static void join(BitVector &dst, const BitVector &src) {
+      dst |= src;
+    }
+    static void intersect(BitVector &dst, const BitVector &src) {
+      dst &= src;
+    }
+    static void subtract(BitVector &dst, const BitVector &src) {
+      dst.reset(src);
+    }
+    static unsigned count(const BitVector &s) {
+      return s.count();
+    }
+    static size_t bytes(const BitVector &s) {
+      return s.getMemorySize();
+    }
+    template <typename Fn>
+    static void forEach(const BitVector &s, Fn fn) {
+      for (int i = s.find_first(); i != -1; i = s.find_next(i)) {
+        fn(i);
+      }
+    }
+  };
+
+  template <> struct LatticeTraits<SparseBitVector<>> {
+    static void init(SparseBitVector<> &s, unsigned width, bool full) {
+      s.clear();
+      if (full) {
+        for (unsigned i = 0; i < width; i++) {
+          s.set(i);
+        }
+      }
+    }
+    static void join(SparseBitVector<> &dst, const SparseBitVector<> &src) {
+      dst |= src;
+    }
+    static void intersect(SparseBitVector<> &dst, const SparseBitVector<> &src) {
+      dst &= src;
+    }
+    static void subtract(SparseBitVector<> &dst, const SparseBitVector<> &src) {
+      dst.intersectWithComplement(src);
+    }
+    static unsigned count(const SparseBitVector<> &s) {
+      return s.count();
+    }
+    // one list node per 128-bit chunk holding a set bit
+    static size_t bytes(const SparseBitVector<> &s) {
+      size_t elements = 0;
+      unsigned last = ~0u;
+      for (auto i : s) {
+        if (i / 128 != last) {
+          last = i / 128;
+          elements++;
+        }
+      }
+      return elements * (sizeof(SparseBitVectorElement<>) + 2 * sizeof(void*));
+    }
+    template <typename Fn>
+    static void forEach(const SparseBitVector<> &s, Fn fn) {
+      for (auto i : s) {
+        fn(i);
+      }
+    }
+  };
+
+  // meet operators; Top is the value every block's OUT starts from
+  struct Union {
+    static const bool TopIsFull = false;
+    template <typename SetT>
+    static void meet(SetT &dst, const SetT &src) {
+      LatticeTraits<SetT>::join(dst, src);
+    }
+  };
+
+  struct Intersection {
+    static const bool TopIsFull = true;
+    template <typename SetT>
+    static void meet(SetT &dst, const SetT &src) {
+      LatticeTraits<SetT>::intersect(dst, src);
+    }
+  };
+
+  // directions: the visiting order, and where a block's facts come from and go to
+  struct Forward {
+    // reverse post-order, unreachable blocks last in layout order
+    static void order(Function &F, std::vector<BasicBlock*> &blocks) {
+      ReversePostOrderTraversal<Function*> RPOT(&F);
+      for (auto* B : RPOT) {
+        blocks.push_back(B);
+      }
+    }
+    template <typename Fn>
+    static void forEachInput(BasicBlock* B, Fn fn) {
+      for (auto PI = pred_begin(B), E = pred_end(B); PI != E; ++PI) {
+        fn(*PI);
+      }
+    }
+    template <typename Fn>
+    static void forEachOutput(BasicBlock* B, Fn fn) {
+      for (auto SI = succ_begin(B), E = succ_end(B); SI != E; ++SI) {
+        fn(*SI);
+      }
+    }
+  };
+
+  struct Backward {
+    // post-order approximates reverse post-order of the reversed CFG
+    static void order(Function &F, std::vector<BasicBlock*> &blocks) {
+      for (auto* B : post_order(&F)) {
+        blocks.push_back(B);
+      }
+    }
+    template <typename Fn>
+    static void forEachInput(BasicBlock* B, Fn fn) {
+      Forward::forEachOutput(B, fn);
+    }
+    template <typename Fn>
+    static void forEachOutput(BasicBlock* B, Fn fn) {
+      Forward::forEachInput(B, fn);
+    }
+  };
+
+  // the classic transfer function: out = gen U (in - kill)
+  template <typename SetT>
+  struct GenKillTransfer {
+    std::vector<SetT> gen, kill;
+    void operator()(unsigned b, const SetT &in, SetT &out) const {
+      out = in;
+      LatticeTraits<SetT>::subtract(out, kill[b]);
+      LatticeTraits<SetT>::join(out, gen[b]);
+    }
+  };
+
+  // convergence counters of one solve()
+  struct SolverStats {
+    // passes over the blocks: a sweep ends whenever the worklist hands out a
+    // block that does not come after the previous one in visiting order
+    unsigned sweeps;
+    // block transfers evaluated, and the instructions in those blocks
+    unsigned blockVisits;
+    unsigned instVisits;
+    // OUT sets compared against their previous value
+    unsigned comparisons;
+  };
+
+  template <typename SetT, typename Direction, typename Meet, typename Transfer>
+  class DataflowSolver {
+  public:
+    typedef LatticeTraits<SetT> Traits;
+
+    // numbers the blocks of F; block numbers are also worklist priorities
+    DataflowSolver(Function &F, unsigned width, Transfer &transfer)
+        : width(width), transfer(transfer) {
+      stats = SolverStats();
+      Direction::order(F, blocks);
+      for (unsigned b = 0; b < blocks.size(); b++) {
+        blockMap[blocks[b]] = b;
+      }
+      for (auto& B : F) {
+        if (blockMap.find(&B) == blockMap.end()) {
+          blockMap[&B] = blocks.size();
+          blocks.push_back(&B);
+        }
+      }
+    }
+
+    unsigned getNumBlocks() const { return blocks.size(); }
+    unsigned getIndex(BasicBlock* B) const { return blockMap.lookup(B); }
+    BasicBlock* getBlock(unsigned b) const { return blocks[b]; }
+    // facts flowing into / out of a block in the analysis direction, i.e.
+    // block entry / exit for forward problems and exit / entry for backward
+    const SetT &getIn(unsigned b) const { return inSets[b]; }
+    const SetT &getOut(unsigned b) const { return outSets[b]; }
+    // how many block transfers the last solve() evaluated
+    unsigned getNumVisits() const { return stats.blockVisits; }
+    const SolverStats &getStats() const { return stats; }
+    // called with true when a sweep starts and with false when it ends
+    void setSweepObserver(std::function<void(bool)> observer) { sweepObserver = observer; }
+    // heap bytes of the IN/OUT sets and the block numbering
+    size_t getMemoryBytes() const {
+      size_t bytes = blocks.capacity() * sizeof(BasicBlock*) + blockMap.getMemorySize()
+        + (inSets.capacity() + outSets.capacity()) * sizeof(SetT);
+      for (unsigned b = 0; b < inSets.size(); b++) {
+        bytes += Traits::bytes(inSets[b]) + Traits::bytes(outSets[b]);
+      }
+      return bytes;
+    }
+
+    // every block starts on the worklist; afterwards a block is queued again
+    // only when one of its inputs changed, and never twice at the same time
+    void solve() {
+      unsigned numBlocks = blocks.size();
+      inSets.assign(numBlocks, SetT());
+      outSets.assign(numBlocks, SetT());
+      for (unsigned b = 0; b < numBlocks; b++) {
+        Traits::init(inSets[b], width, false);
+        Traits::init(outSets[b], width, Meet::TopIsFull);
+      }
+      std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> queue;
+      BitVector onQueue(numBlocks, true);
+      for (unsigned b = 0; b < numBlocks; b++) {
+        queue.push(b);
+      }
+      SetT tempIn, tempOut;
+      stats = SolverStats();
+      unsigned last = numBlocks;
+      while (!queue.empty()) {
+        unsigned b = queue.top();
+        queue.pop();
+        onQueue.reset(b);
+        if (last >= b) {
+          if (sweepObserver) {
+            if (stats.sweeps > 0) {
+              sweepObserver(false);
+            }
+            sweepObserver(true);
+          }
+          stats.sweeps++;
+        }
+        last = b;
+        BasicBlock* B = blocks[b];
+        stats.blockVisits++;
+        stats.instVisits += B->size();
+        bool first = true;
+        Direction::forEachInput(B, [&](BasicBlock* P) {
+          const SetT &input = outSets[blockMap.lookup(P)];
+          if (first) {
+            tempIn = input;
+            first = false;
+          } else {
+            Meet::meet(tempIn, input);
+          }
+        });
+        // boundary blocks (entry / exits) start from the empty set
+        if (first) {
+          Traits::init(tempIn, width, false);
+        }
+        std::swap(inSets[b], tempIn);
+        transfer(b, inSets[b], tempOut);
+        stats.comparisons++;
+        if (tempOut == outSets[b]) {
+          continue;
+        }
+        std::swap(outSets[b], tempOut);
+        Direction::forEachOutput(B, [&](BasicBlock* S) {
+          unsigned s = blockMap.lookup(S);
+          if (!onQueue.test(s)) {
+            onQueue.set(s);
+            queue.push(s);
+          }
+        });
+      }
+      if (sweepObserver && stats.sweeps > 0) {
+        sweepObserver(false);
+      }
+    }
+
+  private:
+    unsigned width;
+    Transfer &transfer;
+    SolverStats stats;
+    std::function<void(bool)> sweepObserver;
+    std::vector<BasicBlock*> blocks;
+    DenseMap<BasicBlock*, unsigned> blockMap;
+    std::vector<SetT> inSets, outSets;
+  };
+
+  // hash-consing store: structurally equal sets share one immutable copy,
+  // so equality is a pointer comparison and a copy is a pointer copy
+  template <typename SetT>
+  class SetInterner {
+  public:
+    const SetT *intern(const SetT &s) {
+      size_t hash = 0;
+      LatticeTraits<SetT>::forEach(s, [&](unsigned i) {
+        hash = hash_combine(hash, i);
+      });
+      auto& bucket = buckets[hash];
+      for (auto* candidate : bucket) {
+        if (*candidate == s) {
+          return candidate;
+        }
+      }
+      sets.push_back(std::unique_ptr<SetT>(new SetT(s)));
+      bucket.push_back(sets.back().get());
+      return sets.back().get();
+    }
+    // number of distinct sets stored
+    unsigned size() const { return sets.size(); }
+    // heap bytes of the stored sets and their hash buckets
+    size_t bytes() const {
+      size_t bytes = sets.capacity() * sizeof(std::unique_ptr<SetT>)
+        + buckets.size() * (sizeof(typename decltype(buckets)::value_type) + 2 * sizeof(void*));
+      for (auto& set : sets) {
+        bytes += sizeof(SetT) + LatticeTraits<SetT>::bytes(*set);
+      }
+      for (auto& bucket : buckets) {
+        bytes += bucket.second.capacity() * sizeof(const SetT*);
+      }
+      return bytes;
+    }
+
+  private:
+    std::unordered_map<size_t, std::vector<const SetT*>> buckets;
+    std::vector<std::unique_ptr<SetT>> sets;
+  };
+
+  // reaching definitions: a forward may (union) gen/kill problem
+  template <typename SetT>
+  using ReachingDefsSolver = DataflowSolver<SetT, Forward, Union, GenKillTransfer<SetT>>;
+}
+
+#endif
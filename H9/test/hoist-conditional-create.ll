@@ -0,0 +1,57 @@
+; Regression test: a read of a create inside a loop is only hoisted when it
+; runs whenever the loop is entered.
+; RUN: opt -load %shlibdir/CatPass.so -CAT -S %s | FileCheck %s
+
+declare i8* @CAT_create_signed_value(i64)
+declare i64 @CAT_get_signed_value(i8*)
+declare void @escape(i8*)
+
+; CHECK-LABEL: @conditional
+; CHECK: loop:
+; CHECK: then:
+; CHECK-NEXT: call i64 @CAT_get_signed_value
+define i64 @conditional(i64 %n, i64 %k) {
+entry:
+  %a = call i8* @CAT_create_signed_value(i64 %n)
+  call void @escape(i8* %a)
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %latch ]
+  %c = icmp eq i64 %i, %k
+  br i1 %c, label %then, label %latch
+then:
+  %x = call i64 @CAT_get_signed_value(i8* %a)
+  br label %latch
+latch:
+  %v = phi i64 [ %x, %then ], [ 0, %loop ]
+  %s.next = add i64 %s, %v
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+exit:
+  ret i64 %s.next
+}
+
+; CHECK-LABEL: @always
+; CHECK: entry:
+; CHECK: call i64 @CAT_get_signed_value
+; CHECK: loop:
+; CHECK-NOT: call i64 @CAT_get_signed_value
+; CHECK: exit:
+define i64 @always(i64 %n) {
+entry:
+  %a = call i8* @CAT_create_signed_value(i64 %n)
+  call void @escape(i8* %a)
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %loop ]
+  %x = call i64 @CAT_get_signed_value(i8* %a)
+  %s.next = add i64 %s, %x
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+exit:
+  ret i64 %s.next
+}
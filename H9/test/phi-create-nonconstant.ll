@@ -0,0 +1,60 @@
+; Regression test: a CAT value merged by a phi is only folded when every
+; incoming cell is a create of the same constant that is never written.
+; RUN: opt -load %shlibdir/CatPass.so -CAT -S %s | FileCheck %s
+
+declare i8* @CAT_create_signed_value(i64)
+declare void @CAT_binary_add(i8*, i8*, i8*)
+declare i64 @CAT_get_signed_value(i8*)
+
+; CHECK-LABEL: @nonconstant
+; CHECK: call i64 @CAT_get_signed_value
+define i64 @nonconstant(i64 %n, i1 %c) {
+entry:
+  br i1 %c, label %then, label %else
+then:
+  %a = call i8* @CAT_create_signed_value(i64 1)
+  br label %join
+else:
+  %b = call i8* @CAT_create_signed_value(i64 %n)
+  br label %join
+join:
+  %p = phi i8* [ %a, %then ], [ %b, %else ]
+  %x = call i64 @CAT_get_signed_value(i8* %p)
+  ret i64 %x
+}
+
+; CHECK-LABEL: @written
+; CHECK: call i64 @CAT_get_signed_value
+define i64 @written(i1 %c) {
+entry:
+  br i1 %c, label %then, label %else
+then:
+  %a = call i8* @CAT_create_signed_value(i64 1)
+  br label %join
+else:
+  %b = call i8* @CAT_create_signed_value(i64 1)
+  br label %join
+join:
+  %p = phi i8* [ %a, %then ], [ %b, %else ]
+  call void @CAT_binary_add(i8* %p, i8* %p, i8* %p)
+  %x = call i64 @CAT_get_signed_value(i8* %p)
+  ret i64 %x
+}
+
+; CHECK-LABEL: @uniform
+; CHECK-NOT: @CAT_get_signed_value
+; CHECK: ret i64 1
+define i64 @uniform(i1 %c) {
+entry:
+  br i1 %c, label %then, label %else
+then:
+  %a = call i8* @CAT_create_signed_value(i64 1)
+  br label %join
+else:
+  %b = call i8* @CAT_create_signed_value(i64 1)
+  br label %join
+join:
+  %p = phi i8* [ %a, %then ], [ %b, %else ]
+  %x = call i64 @CAT_get_signed_value(i8* %p)
+  ret i64 %x
+}
@@ -0,0 +1,58 @@
+// A CAT runtime that counts invocations, for benchmarking.
+//
+// Implements the CAT API (plus the CAT_sink escape hook catgen.py uses) on
+// heap-allocated 64-bit cells and, at exit, writes the number of CAT calls
+// made (possibly 0) to the file named by CAT_INVOCATIONS, or to stderr.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef void * CATData;
+
+static uint64_t catInvocations = 0;
+
+static void catReport (void) {
+  const char *path = getenv("CAT_INVOCATIONS");
+  FILE *out = path != NULL ? fopen(path, "w") : NULL;
+  fprintf(out != NULL ? out : stderr, "CAT invocations: %llu\n", (unsigned long long)catInvocations);
+  if (out != NULL) {
+    fclose(out);
+  }
+}
+
+__attribute__((constructor)) static void catRegister (void) {
+  atexit(catReport);
+}
+
+static void catCount (void) {
+  catInvocations++;
+}
+
+CATData CAT_create_signed_value (int64_t value) {
+  int64_t *cell = malloc(sizeof(int64_t));
+  catCount();
+  if (cell == NULL) {
+    abort();
+  }
+  *cell = value;
+  return cell;
+}
+
+int64_t CAT_get_signed_value (CATData v) {
+  catCount();
+  return *(int64_t *)v;
+}
+
+void CAT_binary_add (CATData result, CATData v1, CATData v2) {
+  catCount();
+  *(int64_t *)result = *(int64_t *)v1 + *(int64_t *)v2;
+}
+
+void CAT_binary_sub (CATData result, CATData v1, CATData v2) {
+  catCount();
+  *(int64_t *)result = *(int64_t *)v1 - *(int64_t *)v2;
+}
+
+void CAT_sink (CATData v) {
+  (void)v;
+}
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+# Synthetic CAT workload generator.
+#
+# Emits C programs written against the CAT API with tunable numbers of
+# functions, blocks, CAT variables, loop nesting, escapes and call-graph
+# depth, so the CatPass of every stage can be timed on inputs of any size.
+#
+#   catgen.py -o corpus -n 20 --functions 50 --blocks 40 --vars 16
+#
+# With --emit-llvm every program is also compiled to bitcode the way the
+# passes expect it (clang -O0 without optnone, then mem2reg).
+
+import argparse
+import os
+import random
+import subprocess
+import sys
+
+HEADER = """#include <stdint.h>
+#include <stdio.h>
+
+typedef void * CATData;
+CATData CAT_create_signed_value (int64_t value);
+int64_t CAT_get_signed_value (CATData v);
+void CAT_binary_add (CATData result, CATData v1, CATData v2);
+void CAT_binary_sub (CATData result, CATData v1, CATData v2);
+
+// defined elsewhere, so the CAT value escapes the function
+void CAT_sink (CATData v);
+"""
+
+
+class Generator:
+  def __init__(self, args, seed):
+    self.args = args
+    self.r = random.Random(seed)
+    self.temp = 0
+
+  def fresh(self, prefix):
+    self.temp += 1
+    return "%s%d" % (prefix, self.temp)
+
+  # one straight-line region: CAT operations, reads, escapes and calls
+  def region(self, catVars, callees, depth):
+    r = self.r
+    out = []
+    for _ in range(self.args.ops):
+      c = r.random()
+      if c < self.args.write_rate:
+        op = r.choice(["add", "sub"])
+        out.append("CAT_binary_%s(%s, %s, %s);" % (op, r.choice(catVars), r.choice(catVars), r.choice(catVars)))
+      elif c < self.args.write_rate + self.args.escape_rate:
+        out.append("CAT_sink(%s);" % r.choice(catVars))
+      elif callees and c < self.args.write_rate + self.args.escape_rate + self.args.call_rate:
+        out.append("acc += %s(%d);" % (r.choice(callees), r.randint(0, 9)))
+      else:
+        out.append("acc += CAT_get_signed_value(%s);" % r.choice(catVars))
+    return out
+
+  # a nest of regions, loops and if/else with about budget regions in total
+  def body(self, catVars, callees, depth, budget):
+    r = self.r
+    out = []
+    while budget > 0:
+      c = r.random()
+      if budget >= 2 and depth < self.args.loop_depth and c < 0.3:
+        inner = r.randint(1, budget - 1)
+        budget -= inner + 1
+        i = self.fresh("i")
+        out.append("for (int64_t %s = 0; %s < n; %s++) {" % (i, i, i))
+        out += ["  " + l for l in self.body(catVars, callees, depth + 1, inner)]
+        out.append("}")
+      elif budget >= 3 and c < 0.6:
+        thenBudget = r.randint(1, budget - 2)
+        elseBudget = r.randint(1, budget - thenBudget - 1)
+        budget -= thenBudget + elseBudget + 1
+        out.append("if (n > %d) {" % r.randint(0, 9))
+        out += ["  " + l for l in self.body(catVars, callees, depth, thenBudget)]
+        out.append("} else {")
+        out += ["  " + l for l in self.body(catVars, callees, depth, elseBudget)]
+        out.append("}")
+      else:
+        budget -= 1
+        out += self.region(catVars, callees, depth)
+    return out
+
+  def function(self, name, callees):
+    r = self.r
+    out = ["int64_t %s (int64_t n) {" % name, "  int64_t acc = 0;"]
+    catVars = []
+    for v in range(self.args.vars):
+      catVars.append("d%d" % v)
+      out.append("  CATData d%d = CAT_create_signed_value(%d);" % (v, r.randint(0, 9)))
+    out += ["  " + l for l in self.body(catVars, callees, 0, self.args.blocks)]
+    out.append("  return acc;")
+    out.append("}")
+    return out
+
+  # functions are split into call_depth levels, and every function calls
+  # only functions of the next level, so the call graph is a DAG that deep
+  def program(self):
+    numFunctions = max(self.args.functions, 1)
+    levels = max(min(self.args.call_depth, numFunctions), 1)
+    names = ["f%d" % f for f in range(numFunctions)]
+    level = [f * levels // numFunctions for f in range(numFunctions)]
+    out = [HEADER]
+    for f in reversed(range(numFunctions)):
+      callees = [names[g] for g in range(numFunctions) if level[g] == level[f] + 1]
+      out += self.function(names[f], callees)
+      out.append("")
+    out.append("int main (int argc, char *argv[]) {")
+    out.append("  int64_t acc = 0;")
+    for f in range(numFunctions):
+      if level[f] == 0:
+        out.append("  acc += %s(argc);" % names[f])
+    out.append('  printf("%lld\\n", (long long)acc);')
+    out.append("  return 0;")
+    out.append("}")
+    return "\n".join(out) + "\n"
+
+
+def emitLLVM(args, src):
+  bc = src[:-2] + ".bc"
+  subprocess.check_call([args.clang, "-O0", "-Xclang", "-disable-O0-optnone", "-emit-llvm", "-c", src, "-o", bc])
+  subprocess.check_call([args.opt, "-mem2reg", bc, "-o", bc])
+
+
+def main():
+  parser = argparse.ArgumentParser(description="generate synthetic CAT programs")
+  parser.add_argument("-o", "--output", default="corpus", help="output directory")
+  parser.add_argument("-n", "--programs", type=int, default=10, help="number of programs")
+  parser.add_argument("--seed", type=int, default=0, help="seed of the first program")
+  parser.add_argument("--functions", type=int, default=8, help="functions per program")
+  parser.add_argument("--blocks", type=int, default=10, help="straight-line regions per function")
+  parser.add_argument("--ops", type=int, default=6, help="CAT operations per region")
+  parser.add_argument("--vars", type=int, default=4, help="CAT variables per function")
+  parser.add_argument("--loop-depth", type=int, default=2, help="maximum loop nesting")
+  parser.add_argument("--call-depth", type=int, default=3, help="levels of the call graph")
+  parser.add_argument("--write-rate", type=float, default=0.3, help="share of add/sub operations")
+  parser.add_argument("--escape-rate", type=float, default=0.05, help="share of escaping operations")
+  parser.add_argument("--call-rate", type=float, default=0.05, help="share of calls")
+  parser.add_argument("--emit-llvm", action="store_true", help="also compile every program to bitcode")
+  parser.add_argument("--clang", default="clang")
+  parser.add_argument("--opt", default="opt")
+  args = parser.parse_args()
+
+  os.makedirs(args.output, exist_ok=True)
+  for p in range(args.programs):
+    src = os.path.join(args.output, "cat%d.c" % p)
+    with open(src, "w") as f:
+      f.write(Generator(args, args.seed + p).program())
+    if args.emit_llvm:
+      emitLLVM(args, src)
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())